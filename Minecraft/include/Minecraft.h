@@ -13,6 +13,7 @@
 
 #include "util/ImGuiManager.h"
 #include "engine/map/World.h" 
+#include "engine/map/ViewDistanceController.h"
 #include "engine/Physics.h"
 #include "engine/Camera.h"
 #include "engine/PlayerController.h"
@@ -7,6 +7,7 @@
 
 #include "util/Debug.h"
 #include "util/MoreMath.h"
+#include "util/Frustum.h"
 
 
 
@@ -38,6 +39,7 @@ public:
 
 	bool InsideFrustrum(glm::vec3 point) const;
 	std::vector<Plane> GetFrustrumPlanes() const;
+	Frustum GetFrustum(float margin = 0.f) const;
 
 
 private:
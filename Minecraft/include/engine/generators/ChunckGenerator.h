@@ -6,30 +6,53 @@
 #include <mutex>
 #include <chrono>
 #include <queue>
+#include <functional>
+#include <atomic>
 
 #include <glm/glm.hpp>
 
 #include "engine/map/Chunck.h"
+#include "engine/map/ChunckPool.h"
+#include "engine/map/MeshCache.h"
 
 class Chunck;
 class SubChunck;
+class ChunckPool;
 
 class ChunckGenerator
 {
 public:
-	ChunckGenerator();
+	ChunckGenerator(ChunckPool * chunckPool, const std::string & meshDirectory);
 	~ChunckGenerator();
 	
 	void UpdateMesh();
 
 	void GenerateBlocks( int x, int z, float priority = 0);
+	void SetLoader(std::function<bool(Chunck *)> load);//Tried by the blocks thread before generating, true when the chunck was loaded instead
 	void GenerateMesh(SubChunck * chunck, float priority = 0);
 
 	std::vector<Chunck *> PopChuncksGenerateds();
-	std::vector<SubChunck *> PopMeshGenerateds();
+	std::vector<SubChunck *> PopMeshGenerateds();//Still generating until the caller made their models
+
+	void CancelBlocks();
+	void CancelMeshes(std::function<bool(SubChunck *)> cancel);
+
+	int BlocksBacklog();
+	int MeshBacklog();
+	float MeshTime() const;//Average seconds spent meshing one subChunck
+	float BlocksTime() const;//Average seconds spent generating the blocks of one chunck
+	uint64_t MeshRounds() const;//Batches done by the mesh thread, the batch in flight when it was read is done once it grew
+	MeshCache & Meshes();
 	
 private:
 	bool m_quitting = false;
+	std::atomic<float> m_meshTime;
+	std::atomic<float> m_blocksTime;
+	std::atomic<uint64_t> m_meshRounds;
+
+	ChunckPool * m_chunckPool;
+	MeshCache m_meshCache;
+	std::function<bool(Chunck *)> m_load;//Guarded by m_chuncksGenBlocksMtx
 
 	void UpdateBlocks();
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+#include "engine/map/Chunck.h"
+#include "engine/map/ChunckPool.h"
+
+class Chunck;
+class ChunckPool;
+
+//Compares the linear and morton storage orders of the subChuncks blocks on the same terrain.
+//Runs headless from the command line (Minecraft --layout-benchmark [size] [runs]), nothing is saved nor drawn.
+//For each layout a square of size * size chuncks is generated, then every pass walking the blocks is timed on one thread:
+//the mesher, the connectivity flood fill (the nearest to a light propagation) and the compression.
+class LayoutBenchmark
+{
+public:
+	struct Result
+	{
+		float blocks;//Milliseconds per chunck, generation with its trees
+		float mesh;//Milliseconds per subChunck
+		float connectivity;
+		float compress;
+		size_t vertices;//Of one meshing pass, the same for both layouts
+	};
+
+	LayoutBenchmark(int size, int runs);
+
+	static int Main(int argc, char ** argv);//Command line entry point, returns the exit code
+
+	Result Run(bool morton);
+
+private:
+	template <typename Pass>
+	float Time(const std::vector<SubChunck*> & subChuncks, Pass pass);//Milliseconds per subChunck, averaged over the runs after a warm up
+
+	int m_size;
+	int m_runs;
+	ChunckPool m_pool;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "engine/map/Chunck.h"
+#include "engine/map/ChunckPool.h"
+#include "engine/map/RegionStore.h"
+#include "engine/map/MeshCache.h"
+
+class Chunck;
+class ChunckPool;
+
+//Generates a rectangle of chuncks on every core and saves them in the region files, the game then loads them instead of generating them.
+//Runs headless from the command line (Minecraft --pregenerate x0 z0 x1 z1 [threads] [--meshes]), no window nor graphics context is created.
+//With --meshes the meshes are saved in the mesh cache too.
+//The rectangle is swept row by row, only the rows around the one being completed are in memory.
+class Pregenerator
+{
+public:
+	Pregenerator(const std::string & directory, int threads, bool saveMeshes);
+
+	static int Main(int argc, char ** argv);//Command line entry point, returns the exit code
+
+	void Generate(int x0, int z0, int x1, int z1);//Inclusive chunck coordinates
+
+	int Saved() const;
+	int Skipped() const;//Already in the region files, kept as they are
+	size_t Bytes() const;//Compressed size of the saved chuncks
+	float Time() const;//Seconds
+	float BlocksTime() const;
+	float TreesTime() const;
+	float MeshTime() const;
+
+private:
+	typedef std::vector<Chunck*> Row;//From x0 - 1 to x1 + 1, the border chuncks only receive trees from the inside
+
+	void ParallelFor(int count, std::function<void(int)> task);
+	Row GenerateRow(int z, Row * previous);
+	void LateGenerateRow(Row & row);
+	void CompleteRow(Row & row);
+	void ReleaseRow(Row & row);
+
+	int m_threads;
+	int m_x0;
+	int m_x1;
+
+	ChunckPool m_pool;
+	RegionStore m_regions;
+	MeshCache m_meshes;
+
+	std::atomic<int> m_saved;
+	std::atomic<int> m_skipped;
+	std::atomic<size_t> m_bytes;
+	float m_time = 0.f;
+	float m_blocksTime = 0.f;
+	float m_treesTime = 0.f;
+	float m_meshTime = 0.f;
+};
@@ -32,7 +32,7 @@ class TreeGen
 {
 public:
 	TreeGen();
-	Node * GenerateTree(glm::vec3 position, float maxLenght);
+	Node * GenerateTree(glm::vec3 position, float maxLenght, unsigned seed);
 
 private:
 	Node * NewNode(Node* parent, int depth);
@@ -5,54 +5,79 @@
 #include "util/Perlin.h"
 
 class SubChunck;
+class ChunckPool;
 
 class Chunck
 {
 public:
 
-	Chunck(  int x, int z );
+	Chunck( ChunckPool * pool );
 	~Chunck();
 
+	void Reset(int x, int z);
+	void Unload();
+
 	static const int height = 12;
 
+	//Highest block of each column counting only some block types
+	enum Heightmap { surface, solid, opaque, heightmapsCount };//Any block but air, blocks with colliders, blocks hiding what is behind them
+
 	void Update(float delta);
 
-	void DrawTransparent(const Shader & shader) const;
-	void DrawOpaque(const Shader & shader) const;
+	void DrawTransparent(std::vector<MeshArena::DrawCall> & draws) const;
+	void DrawOpaque(std::vector<MeshArena::DrawCall> & draws) const;
+	void DrawCasters(std::vector<MeshArena::DrawCall> & draws, uint32_t subChuncks) const;//Bit y set for the subChunck y
 
 	SubChunck* GetSubChunck( int  height);
-	Block* GetBlock(glm::ivec3 position);
+	Chunck * Neighbour(int face) const;//SubChunck::Face
+	void SetNeighbour(int face, Chunck * chunck);
+	const Block* GetBlock(glm::ivec3 position) const;
+	void SetBlock(glm::ivec3 position, Block::Type type);
+	int Height(int x, int z, Heightmap heightmap = surface) const;//Y of the highest block + 1, 0 for an empty column
 
 	void GenerateBlocks(); 
-	void LateGenerateBlocks();
+	void LateGenerateBlocks(std::vector<SubChunck*> & spilled);//Fills spilled with the neighbours subChuncks changed by the trees
 	void GenerateMesh(int subChunck);
 	void GenerateModels(int subChunck);
 	void GenerateCollider(int subChunck, bool regenerate = false );
 
-	void GenerateTree(Node * tree);
+	void GenerateTree(Node * tree, std::vector<SubChunck*> & spilled);
+
+	void Compress(std::vector<uint8_t> & data) const;
+	bool Decompress(const uint8_t * data, size_t size);//False if the data is corrupted
 
 	void SetEnabled(bool state);
 	void SetSubChunckEnabled(int subChunck, bool state);
+	void SetModified(bool state);
+	void SetResident(bool state);//In the chuncks map of the world, staged and deleted chuncks are not drawn
 
 	bool Enabled() const;
+	bool Resident() const;
 	bool BlocksGenerated() const;
+	bool LateGenerated() const;
+	bool Modified() const;
 
 	glm::ivec3 Position() const;
 private:
-	
+	Chunck * Locate(glm::ivec3 & position);//Chunck holding a world position through the neighbours, position becomes local
+	static bool InHeightmap(const Block & block, int heightmap);
+	void UpdateHeights(glm::ivec3 position, Block::Type type);
+	void BuildHeightmaps();
+
 	bool m_enabled;
+	bool m_resident = false;
 	bool m_generateLater = false;
 	bool m_blocksGenerated = false;
+	bool m_lateGenerated = false;//Trees placed, the blocks are complete
+	bool m_modified = false;//The blocks differ from the copy saved on disk, or from a new generation when none was saved
 
 	int m_positionX;
 	int m_positionZ;
 
 	SubChunck * m_subChuncks[Chunck::height];
+	uint8_t m_heights[heightmapsCount][16 * 16];//SubChunck::size * SubChunck::size columns indexed by x * SubChunck::size + z, maintained by SetBlock
+	Chunck * m_neighbours[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };//Only the horizontal faces are used
 	static PerlinNoise perlinGen;
 
 	std::vector< Node *> m_pendingTrees;
-
-	static TreeGen m_treeGen;
-	static std::default_random_engine generator;
-	static std::uniform_real_distribution<float> distribution;
 };
\ No newline at end of file
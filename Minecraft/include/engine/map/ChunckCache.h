@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "engine/map/ChunckMap.h"
+
+class Chunck;
+
+//Run length encoded copies of the chuncks evicted from the world, the least recently stored are forgotten first.
+//Chuncks entering the world again are decoded instead of generated, player edits included.
+class ChunckCache
+{
+public:
+	ChunckCache(size_t capacity = defaultCapacity);
+
+	static const size_t defaultCapacity = 64 * 1024 * 1024;//Bytes
+
+	void Store(int x, int z, const std::vector<uint8_t> & data);//Chunck::Compress data
+	bool Restore(Chunck * chunck);//Decodes into a chunck reset at the cached position and forgets the copy
+	bool Contains(int x, int z) const;
+
+	void SetCapacity(size_t capacity);
+	size_t Capacity() const;
+	size_t Size() const;
+	int Count() const;
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		std::vector<uint8_t> data;
+	};
+
+	void Erase(std::list<Entry>::iterator entry);
+	void Trim();
+
+	std::list<Entry> m_entries;//Most recently stored first
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+
+	size_t m_capacity;
+	size_t m_size;
+};
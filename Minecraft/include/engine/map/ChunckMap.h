@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+class Chunck;
+
+//Sparse storage of chuncks keyed by their 64 bits packed coordinates.
+//Open addressing with linear probing, the capacity is a power of two and the table stays at most half full.
+class ChunckMap
+{
+public:
+	ChunckMap(int capacity = 1024);
+
+	static uint64_t Key(int x, int z);
+	static int KeyX(uint64_t key);
+	static int KeyZ(uint64_t key);
+
+	Chunck * Get(int x, int z) const;
+	void Set(int x, int z, Chunck * chunck);//nullptr removes the chunck
+	void Clear();
+
+	int Count() const;
+	uint32_t Version() const;//Changes whenever a chunck is added, replaced or removed
+	int Capacity() const;
+	Chunck * At(int slot) const;//Iteration over the slots, nullptr when the slot is empty
+
+private:
+	struct Slot
+	{
+		uint64_t key;
+		Chunck * chunck;
+	};
+
+	static uint64_t Hash(uint64_t key);
+	void Erase(int slot);
+	void Rehash(int capacity);
+
+	std::vector<Slot> m_slots;
+	uint64_t m_mask;
+	int m_count;
+	uint32_t m_version;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+#include "engine/map/Chunck.h"
+#include "graphics/MeshArena.h"
+#include "graphics/GpuCuller.h"
+
+class Chunck;
+
+//Owns every chunck of the world and recycles them when they stream out.
+//Blocks are carved from contiguous slabs and only given to the subChuncks that are not a single block type.
+//Meshes are suballocated from a single vertex buffer and can be culled on the GPU.
+class ChunckPool
+{
+public:
+	ChunckPool(int capacity);
+	~ChunckPool();
+
+	static const int growSize = 32;//Number of chuncks created when the pool is empty
+	static const int slabSize = 64;//Number of subChuncks blocks per slab
+
+	Chunck * Acquire(int x, int z);
+	void Release(Chunck * chunck);
+
+	Block * AcquireBlocks();//SubChunck::volume blocks
+	void ReleaseBlocks(Block * blocks);
+	MeshArena & Arena();//Vertices of the subChuncks meshes, staged by any thread (MeshArena::Stage is locked), allocated and drawn by the main thread
+	GpuCuller & Culler();//Records of the subChuncks meshes, main thread only
+
+	int Capacity() const;
+	int Available() const;
+	int BlocksInUse() const;
+
+private:
+	void Grow(int count);
+	void GrowBlocks();
+
+	mutable std::mutex m_mutex;
+
+	std::vector<Block*> m_slabs;
+	std::vector<Block*> m_freeBlocks;
+	std::vector<Chunck*> m_chuncks;
+	std::vector<Chunck*> m_free;
+
+	MeshArena m_arena;
+	GpuCuller m_culler;
+};
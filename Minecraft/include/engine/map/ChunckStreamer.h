@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <unordered_set>
+#include <map>
+#include <set>
+#include <deque>
+#include <iostream>
+
+#include "graphics/GpuCuller.h"
+#include "engine/map/World.h"
+#include "engine/map/ChunckPool.h"
+#include "engine/map/ChunckMap.h"
+#include "engine/map/ChunckCache.h"
+#include "engine/map/RegionStore.h"
+#include "engine/map/EditJournal.h"
+#include "engine/map/MeshCache.h"
+#include <engine/generators/ChunckGenerator.h>
+
+
+class ChunckGenerator;
+class ChunckPool;
+class MeshCache;
+class World;
+class Chunck;
+class SubChunck;
+
+//Keeps resident the chuncks inside the load radius of at least one anchor (players, cameras, physics bodies).
+//Chuncks shared by several anchors are loaded once.
+class ChunckStreamer
+{
+public:
+	ChunckStreamer( int expectedSize );
+	~ChunckStreamer();
+
+	void Update(float delta);
+	void UpdateActive(float delta);
+	void ScheduleUpdate(SubChunck * subChunck);
+	void UpdateSubChunckMesh( SubChunck* subChunck);
+	void RecordEdit(glm::ivec3 position, Block::Type oldType, Block::Type newType, uint32_t tick);
+	void SetScratchJournal(EditJournal * journal);//Edits recorded there instead of the world journal, nullptr to restore it
+	bool Resident(int x, int z) const;
+
+	int AddAnchor(glm::ivec2 center, int size);
+	void RemoveAnchor(int anchor);
+	void Move(int anchor, int dx, int dz);
+	void Recenter(int anchor, int originX, int originZ);
+	void Resize(int anchor, int size);
+	void Prefetch(int anchor, glm::vec2 direction);
+
+	int Size(int anchor) const;
+	int OriginX(int anchor) const;
+	int OriginZ(int anchor) const;
+
+	Chunck* Get(int x, int z) const;
+	const ChunckMap & Chuncks() const;
+	ChunckCache & Cache();
+	MeshCache & Meshes();
+	MeshArena & Arena();
+	GpuCuller & Culler();
+
+	int ResidentCount() const;
+	int StagedCount() const;
+	int GeneratorBacklog() const;
+	float MeshTime() const;
+	float GenerationTime() const;
+	float LoadTime() const;
+	int ActiveCount() const;
+
+	static const int maxPrefetchDepth = 3;//Rows generated ahead of the radius boundary
+	static const size_t uploadBudget = 4 << 20;//Bytes of meshes uploaded per frame, the rest waits for the next frames
+
+private:
+	//Square window of an anchor, the resident chuncks are the disc inscribed in it
+	struct Anchor
+	{
+		bool used;
+		int originX;
+		int originZ;
+		int size;
+		std::vector<glm::ivec2> spiral;//Offsets from the origin of the cells inside the radius, sorted from the center outward
+	};
+
+	void SetAnchor(int anchor, const Anchor & state, bool stageLeaving);
+	void Set(int x, int z, Chunck* chunck);
+	void DeleteChunck( Chunck * chunck);
+	void StageChunck(Chunck * chunck);
+	void ForgetPendingWork(Chunck * chunck);
+	Chunck * RestoreChunck(int x, int z);
+	void ReplayEdits(Chunck * chunck);
+	bool LoadCachedMesh(SubChunck * subChunck);
+	void CompactJournal();
+	void LoadChunck(int x, int z, float priority);
+	void PrefetchChunck(int x, int z, float priority);
+	void EvictStaging();
+	static bool InsideAnchor(const Anchor & anchor, int x, int z);
+	float DistanceToCenter(int x, int z) const;
+	int DistanceOutside(int x, int z) const;
+	static std::vector<glm::ivec2> BuildSpiral(int size);
+
+	std::vector<Anchor> m_anchors;
+
+	ChunckPool * m_chunckPool;
+	ChunckGenerator * m_chunckGenerator;
+
+	ChunckMap m_chuncks;
+	ChunckCache m_cache;//Evicted chuncks, restored instead of generated
+	RegionStore m_regions;//Chuncks saved on disk, loaded instead of generated
+	EditJournal m_journal;//Player edits not in the region files yet
+	EditJournal * m_scratchJournal = nullptr;//Benchmarks, never replayed nor compacted
+
+	std::vector<std::pair<Chunck*, uint64_t>> m_toDelete;//With the mesh round in flight when deleted, a subChunck meshed then may read its blocks
+	std::vector<Chunck*> m_waitingFirstGen;//Wait for neighbours generation
+	std::vector<Chunck*> m_waitingLateGen;//Neighbours generated, wait for trees and mesh
+	std::unordered_set<SubChunck*> m_genMeshLater;
+	std::deque<SubChunck*> m_waitingModels;//Meshed, wait for the upload budget
+	std::unordered_set<SubChunck*> m_active;//SubChuncks with pending work, the only ones updated
+
+	//Generated chuncks outside every radius, moved into the world without generation when a boundary shifts.
+	//Chuncks leaving a radius are staged first, so moving back and forth across a boundary never evicts them
+	std::map<std::pair<int, int>, Chunck*> m_staging;
+	std::set<std::pair<int, int>> m_requested;//Sent to the generator, not generated yet
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "engine/map/ChunckMap.h"
+
+//Append only log of the player edits, written and synced to disk by a background thread every syncDelay.
+//Edits found on disk at startup are replayed over the chuncks when they are generated or loaded.
+//Once the edited chuncks are saved in the region files, the journal is compacted (started again empty).
+class EditJournal
+{
+public:
+	struct Edit
+	{
+		glm::ivec3 position;
+		uint8_t oldType;
+		uint8_t newType;
+		uint32_t tick;
+	};
+
+	EditJournal(const std::string & path);
+	~EditJournal();
+
+	static const float syncDelay;//Seconds between two syncs of the journal file
+	static const int compactSize = 8192;//Edits after which the journal should be compacted
+	static const int recordSize = 18;//Bytes of an edit on disk
+
+	void Append(const Edit & edit);
+	std::vector<Edit> TakeReplay(int chunckX, int chunckZ);
+
+	std::vector<glm::ivec2> EditedChuncks() const;//Chuncks edited since the last compaction
+	void Compact(std::function<void()> waitSnapshots);//The journal restarts empty, the previous file is removed once waitSnapshots returns
+	bool Compacting() const;
+	int Size() const;//Edits since the last compaction
+
+private:
+	void Read(const std::string & path);
+	void Write(const Edit & edit);
+	void Flush(FILE * file, const std::vector<uint8_t> & buffer);
+	void UpdateSync();
+
+	std::string m_path;
+	std::string m_oldPath;//Journal being compacted
+	FILE * m_file;
+
+	std::mutex m_fileMtx;//The file is synced without blocking the edits
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<uint8_t> m_buffer;//Edits not written yet
+	std::unordered_map<uint64_t, std::vector<Edit>> m_replay;//Edits read at startup, per chunck
+	std::unordered_set<uint64_t> m_edited;
+	int m_size;
+	std::function<void()> m_waitSnapshots;
+	bool m_compacting = false;
+	bool m_quitting = false;
+
+	std::thread * m_syncThread;
+};
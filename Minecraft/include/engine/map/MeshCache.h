@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "graphics/Mesh.h"
+#include "util/MappedFile.h"
+
+class SubChunck;
+
+//SubChuncks meshes saved on disk, loaded instead of meshing the subChunck again.
+//A mesh is valid while SubChunck::ContentHash is the same, a subChunck or a border block that changed replaces it.
+//Region files of regionSize * regionSize chuncks: a header, a table of the subChuncks meshes, then the opaque and transparent vertices as uploaded to the GPU.
+//Loads stage the vertices straight from the memory mapped file, saves are gathered and appended by a background thread.
+class MeshCache
+{
+public:
+	MeshCache(const std::string & directory);
+	~MeshCache();
+
+	static const int regionSize = 32;
+	static const uint32_t version = 2;//Increase when the meshing changes, every saved mesh is then ignored
+	static const float flushDelay;//Seconds the saves are gathered before hitting the disk
+
+	bool Load(SubChunck * subChunck, uint64_t hash, float & meshTime);//Stages the subChunck vertices if its saved mesh has the same hash, meshTime: seconds its meshing took
+	void Save(const SubChunck * subChunck, uint64_t hash, float meshTime);
+	void Flush();
+	void AddTimeSaved(float seconds);
+
+	void SetEnabled(bool state);
+	bool Enabled() const;
+
+	float HitRate() const;
+	float TimeSaved() const;//Seconds of meshing avoided
+	int PendingWrites();
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		uint32_t offset;//Bytes from the start of the file
+		uint32_t opaqueCount;//Vertices, both counts are 0 when nothing is saved
+		uint32_t transparentCount;
+		float meshTime;
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t height;//Chunck::height, the table has regionSize * regionSize * height entries
+		uint32_t vertexSize;
+	};
+
+	struct Region
+	{
+		std::mutex mutex;
+		MappedFile file;
+		bool valid = false;//The mapped file has a compatible header and a whole table
+	};
+
+	struct Write
+	{
+		uint64_t hash;
+		float meshTime;
+		uint32_t opaqueCount;
+		std::vector<Mesh::Vertex> vertices;//Opaque then transparent
+	};
+
+	typedef std::map<int, Write> RegionWrites;//By entry index
+
+	Region * GetRegion(uint64_t key);
+	std::string RegionPath(int regionX, int regionZ) const;
+	static bool ValidFile(const MappedFile & file);
+	static int EntryIndex(glm::ivec3 position);
+	static size_t TableSize();
+	static void Stage(SubChunck * subChunck, const Mesh::Vertex * vertices, uint32_t opaqueCount, uint32_t transparentCount);
+	void WriteRegion(uint64_t key, const RegionWrites & writes);
+	void UpdateWrites();
+
+	std::string m_directory;
+	std::atomic<bool> m_enabled;
+
+	std::mutex m_regionsMtx;
+	std::unordered_map<uint64_t, Region *> m_regions;
+
+	//Meshes waiting to be written by region, a subChunck saved twice before a flush is written once
+	std::mutex m_writesMtx;
+	std::condition_variable m_writesCondition;
+	std::unordered_map<uint64_t, RegionWrites> m_pendingWrites;
+	std::unordered_map<uint64_t, RegionWrites> m_currentWrites;//Being written by the background thread
+	bool m_flushRequested = false;
+	bool m_quitting = false;
+
+	std::atomic<int> m_hits;
+	std::atomic<int> m_misses;
+	mutable std::mutex m_timeMtx;
+	float m_timeSaved;
+
+	std::thread * m_writeThread;
+};
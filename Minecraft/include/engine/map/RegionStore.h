@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "engine/map/ChunckMap.h"
+#include "util/MappedFile.h"
+
+class Chunck;
+
+//Chuncks saved on disk in region files of regionSize * regionSize chuncks.
+//A region file is a header, a table of the chuncks offsets and sizes, then the compressed chuncks (Chunck::Compress).
+//Reads decode straight from the memory mapped file, writes are coalesced and appended by a background thread before the table points to them.
+class RegionStore
+{
+public:
+	RegionStore(const std::string & directory);
+	~RegionStore();
+
+	static const int regionSize = 32;
+	static const uint32_t version = 1;
+	static const float flushDelay;//Seconds the writes are gathered before hitting the disk
+
+	bool Contains(int x, int z);
+	bool Load(Chunck * chunck);//Decodes the saved chunck at the chunck position
+	void Save(int x, int z, const std::vector<uint8_t> & data);
+	void Flush();
+
+	float LoadTime() const;//Average seconds to load a chunck
+	int PendingWrites();
+
+private:
+	struct Entry
+	{
+		uint32_t offset;
+		uint32_t size;//0 when the chunck is not saved
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t layout;//SubChunck storage order of the blocks
+		uint32_t height;//Chunck::height
+		Entry entries[regionSize * regionSize];
+	};
+
+	struct Region
+	{
+		std::mutex mutex;
+		MappedFile file;
+		bool valid = false;//The mapped file has a compatible header
+	};
+
+	Region * GetRegion(int regionX, int regionZ);
+	std::string RegionPath(int regionX, int regionZ) const;
+	static bool ValidHeader(const Header & header);
+	static int EntryIndex(int x, int z);
+	void WriteRegion(int regionX, int regionZ, const std::vector<std::pair<int, const std::vector<uint8_t> *>> & chuncks);
+	void UpdateWrites();
+
+	std::string m_directory;
+
+	std::mutex m_regionsMtx;
+	std::unordered_map<uint64_t, Region *> m_regions;
+
+	//Chuncks waiting to be written, a chunck saved twice before a flush is written once
+	std::mutex m_writesMtx;
+	std::condition_variable m_writesCondition;
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_pendingWrites;
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_currentWrites;//Being written by the background thread
+	bool m_flushRequested = false;
+	bool m_quitting = false;
+
+	std::atomic<float> m_loadTime;//Written by the generator thread
+
+	std::thread * m_writeThread;
+};
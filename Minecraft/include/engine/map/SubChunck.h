@@ -1,10 +1,12 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <atomic>
 
 
 #include "graphics/Shader.h"
 #include "graphics/Model.h"
+#include "graphics/MeshArena.h"
 #include "graphics/TexturesBlocks.h"
 
 #include "engine/Physics.h"
@@ -15,51 +17,118 @@
 #include "util/Statistics.h"
 
 class World;
+class Chunck;
+class ChunckPool;
 
 class SubChunck : public Statistics
 {
 public:
 	friend class Chunck;
+	friend class MeshCache;
+	friend class LayoutBenchmark;
+	friend class Checks;
 	static const int size = 16;
+	static const int volume = size * size * size;
 
-	SubChunck(glm::ivec3 position, Chunck * parent);
+	enum Face { right, left, top, bottom, front, back };//+x -x +y -y +z -z, the opposite face is face ^ 1
+
+	SubChunck(Chunck * parent, ChunckPool * pool);
 	~SubChunck();
 
+	void Reset(glm::ivec3 position);
+	void Unload();
+
 	void Update(float delta);
+	bool PendingUpdate() const;
 	void SetEnabled(bool state);
+	bool Enabled() const;
+	bool HasMesh() const;//Uploaded in the mesh arena
 
 	void GenerateCollider(bool now = false);
 	void GenerateMesh();
+	void ComputeConnectivity();//Any thread, with the mesh
+	bool Connected(int from, int to) const;//Faces linked through non opaque blocks
+	int SolidLayers() const;//Bottom layers made only of opaque blocks, an occluder box
+	int TriangleCount() const;//Uploaded in the mesh arena
+	static uint32_t ConnectivityVersion();
+	void StageMesh();//Moves the vertices in the staging ring of the pool, any thread
 	void GenerateModels();
-
-	void DrawTransparent(const Shader & shader) const;
-	void DrawOpaque(const Shader & shader) const;
-
-	Block* GetBlock(glm::ivec3 position);
+	void UpdateCullRecord();//Drawn by the GPU culling only while resident, enabled and meshed
+	size_t MeshBytes() const;//Vertices waiting for GenerateModels
+
+	void DrawTransparent(std::vector<MeshArena::DrawCall> & draws) const;
+	void DrawOpaque(std::vector<MeshArena::DrawCall> & draws) const;
+	void DrawCaster(std::vector<MeshArena::DrawCall> & draws) const;//Opaque mesh, even when clipped from the camera
+
+	static int Index(int x, int y, int z);
+	static bool MortonLayout();//Blocks stored in Z-order, neighbours along every axis share cache lines
+	static void SetMortonLayout(bool state);//Before any block is stored, the blocks in memory are not reordered
+	const Block* GetBlock(glm::ivec3 position) const;
+	const Block* GetBlockOrNeighbour(glm::ivec3 position) const;
+	void SetBlock(glm::ivec3 position, Block::Type type);
+	void Compact();
+	void Compress(std::vector<uint8_t> & data) const;
+	const uint8_t * Decompress(const uint8_t * data, const uint8_t * end);//Returns the data following the subChunck, nullptr if corrupted
+	bool Uniform() const;
+	int Count(Block::Type type) const;//Blocks of a type in the subChunck
+	void FindBlocks(Block::Type type, glm::ivec3 min, glm::ivec3 max, std::vector<glm::ivec3> & found);//Local positions inside [min, max]
+	bool HasFaces() const;//False for air and buried subChuncks
+	uint64_t ContentHash() const;//Hash of the blocks and of the blocks bordering the subChunck, the mesh depends on nothing else
+	Block::Type UniformType() const;
+	SubChunck * Neighbour(Face face) const;
 	glm::ivec3 Position() const;
 
 	bool generating = false;
+	uint32_t visibleMark = 0;//Last occlusion pass which reached the subChunck
+	uint8_t skyFaces = 0;//Faces through which the light can enter, 0 when sealed from the sky
 private:
 	Chunck * m_parent;
 
-	void CheckEmpty();
-	bool m_isEmpty = true;
+	void Materialize();
+	bool Buried() const;
 	bool m_colliderGenerated = false;
 	bool m_regenerateColliderNextUpdate = false;
 	bool m_enabled = true;
 
 	glm::ivec3 m_position;
 
-	Block m_blocks[SubChunck::size][SubChunck::size][SubChunck::size];
+	//Maintained by the parent chunck when chuncks are loaded and evicted
+	SubChunck * m_neighbours[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+
+	//A subChunck made of a single block type has no blocks array, it is acquired from the pool on the first different block
+	ChunckPool * m_pool;
+	std::atomic<Block *> m_blocks;//SubChunck::volume blocks owned by the ChunckPool, nullptr when uniform. Published filled, read by the mesh thread
+	Block m_uniform;
+	static bool m_mortonLayout;//Storage order of every blocks array
 
-	//Collider
+	//Bit 6 * from + to set when a path of non opaque blocks links the two faces, every face is linked before the first computation
+	static const uint64_t allConnected = (1ull << 36) - 1;
+	static std::atomic<uint32_t> m_connectivityVersion;//Changes with the connectivity of any subChunck
+	std::atomic<uint64_t> m_connectivity;
+	std::atomic<int> m_solidLayers;
+
+	//Blocks index, the histogram is always up to date, the rows are built by the first FindBlocks and then maintained by SetBlock
+	void BuildTypeRows();
+	uint16_t m_typeCounts[Block::Type::count];
+	std::vector<uint16_t> m_typeRows;//Block::count * size * size rows, bit z of the row (x, y) set when the block (x, y, z) has the type
+
+	//Collider (allocated on first use and kept when the chunck is recycled)
 	RigidBody * m_rb;
-	btTriangleMesh m_btMesh;
+	btTriangleIndexVertexArray * m_btMesh = nullptr;//Points into the two arrays below
+	btAlignedObjectArray<btVector3> m_colliderVertices;//Only their size is reset by the next collider, the memory is reused
+	btAlignedObjectArray<int> m_colliderIndices;
 	btBvhTriangleMeshShape * m_shape = nullptr;
 
 	std::vector<Mesh::Vertex> m_verticesOpaque;
 	std::vector<Mesh::Vertex> m_verticesTransparent;
 
-	Model * m_modelOpaque;
-	Model * m_modelTransparent;
+	//Vertices written by the mesher in the staging ring, empty when kept in the vectors above
+	UploadRing::Slice m_stagedOpaque;
+	UploadRing::Slice m_stagedTransparent;
+
+	int m_cullSlot = -1;//Record of the meshes in the GPU culler of the pool
+
+	//Vertices uploaded in the mesh arena of the pool
+	MeshArena::Allocation m_meshOpaque;
+	MeshArena::Allocation m_meshTransparent;
 };
\ No newline at end of file
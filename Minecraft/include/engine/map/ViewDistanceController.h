@@ -0,0 +1,27 @@
+#pragma once
+
+#include "engine/map/World.h"
+#include "util/Time.h"
+
+//Adjusts the world size from the measured frame time and the chuncks generator backlog
+class ViewDistanceController
+{
+public:
+	ViewDistanceController();
+	void Update(float frameTime);
+
+	void SetEnabled(bool state);
+	bool Enabled() const;
+
+	float AverageFrameTime() const;
+
+	float targetFrameTime = 1.f / 60.f;//Seconds spent drawing a frame
+	int maxBacklog = 128;//Pending blocks and mesh generations tolerated before shrinking
+	float cooldown = 1.f;//Seconds between two changes
+	int step = 2;//Chuncks added or removed at each change
+
+private:
+	bool m_enabled;
+	float m_averageFrameTime;
+	float m_lastChange;
+};
@@ -2,41 +2,123 @@
 
 #include <stack>
 #include <limits>
+#include <random>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
 
 #include "graphics/Drawable.h"
 #include "engine/Physics.h"
 #include "engine/map/Chunck.h"
 #include "engine/Camera.h"
-#include "engine/map/CircularArray.h"
+#include "engine/map/ChunckStreamer.h"
+#include "util/MoreMath.h"
+#include "util/OcclusionBuffer.h"
 #include "util/Perlin.h"
+#include "util/Time.h"
 
 class Chunck;
-class CircularArray;
+class SubChunck;
+class ChunckStreamer;
 
 class World : IWithDebug
 { 
 public:
-	const static int size = 24;
+	const static int defaultSize = 24;//Width in chuncks of the loaded area
+	const static int minSize = 8;
+	const static int maxSize = 64;
+	const static int spectatorAnchorSize = 12;//Chuncks kept around a free camera
+	const static int physicsAnchorSize = 4;//Chuncks kept around a simulated body away from the player
+	const static int recenterDistance = 4;//Chuncks off-center beyond which the world is recentered in one step
+	const static float prefetchTime;//Seconds of movement anticipated by the chuncks prefetching
+	const static float cullReuseDistance;//The clipping is reused while the camera moved less than this
+	const static float cullReuseAngle;//Radians
+	const static int maxOccluders = 256;//Closest solid boxes drawn in the occlusion buffer
+	const static float occluderDistance;
+	const static int maxMeshChanges = 4096;//Recent meshes changes kept for the shadow maps, older ones invalidate every map
  
 	static void Update(float delta);
+	static void ScheduleUpdate(SubChunck * subChunck);
+	static int ActiveSubChuncksCount();
 
 	static void DrawTransparent(const Shader & shader);
 	static void DrawOpaque(const Shader & shader);
+	static void DrawShadowCasters(const Shader & shader, const std::vector<glm::mat4> & projViews);//Casters in any of the volumes, in one pass
+
+	//Meshes uploaded or unloaded, a cached shadow map is rendered again when one of them is in its volume
+	static void MeshChanged(glm::ivec3 subChunckPosition);
+	static uint32_t MeshVersion();
+	static bool MeshesChanged(const glm::mat4 & projView, uint32_t since);
 
 	static Chunck* GetChunck( int x, int z );
-	static Block* GetBlock(glm::ivec3 position);
+	static const Block* GetBlock(glm::ivec3 position);
+	static int Height(int x, int z, int heightmap = 0);//Chunck::Heightmap, y of the highest block + 1 of a column, -1 if not loaded
 
 	static void RemoveBlock(glm::ivec3 position);
 
 
-	static void SetBlock(glm::ivec3 position, Block::Type blockType);
+	static void SetBlock(glm::ivec3 position, Block::Type blockType, bool playerEdit = true);
+	static float EditStorm(glm::ivec3 center, int count);
+	static std::vector<glm::ivec3> FindBlocks(glm::ivec3 center, float radius, const std::vector<Block::Type> & types);
+	static bool AnyBlock(glm::ivec3 center, float radius, const std::vector<Block::Type> & types);
+	static float FindBlocksBenchmark(glm::ivec3 center, float radius, bool indexed);//Seconds of a wood and glass search
 	static glm::ivec3 BlockAt(glm::vec3 worldPos);
+	static glm::ivec3 ChunckAt(glm::vec3 worldPos);
 	static void UpdateAround(glm::ivec3 position);
 	static void UpdateBlock(glm::ivec3 position);
 	static void CenterChuncksAround(glm::ivec3 chunckPos);
+	static int AddAnchor(glm::ivec3 chunckPos, int size);
+	static void MoveAnchor(int anchor, glm::ivec3 chunckPos);
+	static void RemoveAnchor(int anchor);
+	static void PrefetchChuncks(glm::vec3 position, glm::vec3 velocity, glm::vec3 viewDirection);
 	static void EnableAllChuncks();
 	static void ClipChuncks( const Camera & camera );
 	static glm::ivec3 GetOrigin();
+	static int ResidentChuncksCount();
+	static int GeneratorBacklog();
+	static float MeshTime();
+	static float ChunckGenerationTime();
+	static float ChunckLoadTime();
+
+	static int Size();
+	static void SetSize(int size);
+
+	static int CachedChuncksCount();
+	static float CacheSize();//Megabytes
+	static float CacheCapacity();
+	static void SetCacheCapacity(float megabytes);
+
+	static bool MeshCacheEnabled();
+	static void SetMeshCacheEnabled(bool state);
+	static float MeshCacheHitRate();
+	static float MeshCacheTimeSaved();//Seconds
+
+	static bool OcclusionCullingEnabled();
+	static void SetOcclusionCullingEnabled(bool state);
+	static bool RasterOcclusionEnabled();
+	static void SetRasterOcclusionEnabled(bool state);
+	static float RasterOcclusionTime();//Seconds of the last CPU rasterization and tests
+	static int RasterOccluderTriangles();
+	static int RasterCulledCount();
+	static int RasterCulledTriangles();
+	static int FrustumSubChuncksCount();//SubChuncks with a mesh in the frustum
+	static int DrawnSubChuncksCount();//The ones not hidden by the occlusion culling
+
+	//Frustum and Hi-Z culling by a compute shader, replaces ClipChuncks for the camera passes while enabled
+	static bool GpuCullingSupported();
+	static bool GpuCullingEnabled();
+	static void SetGpuCullingEnabled(bool state);
+	static void CullOnGpu(const Camera & camera);
+	static void BuildDepthPyramid(unsigned int depthTexture, int width, int height);//Depth of the frame culled by CullOnGpu
+	static float GpuCullingTime();//Seconds of the last CullOnGpu on the CPU
+	static int GpuCullingRecords();
+
+	static float MeshArenaUsed();//Megabytes
+	static float MeshArenaCapacity();
+	static bool MeshArenaIndirect();
 
 private:
 	void OnDrawDebug() const override;
@@ -48,10 +130,56 @@ private:
 	World(); 
 	~World();
 
-	
-	
-
-	static CircularArray m_array;
+	static int PlayerAnchor();
+	static void CullOccluded(const Camera & camera);
+	static void UpdateSkyVisibility();
+	static void CullRasterized(const Camera & camera);
+	static int CountDrawnSubChuncks();
+	static void QueryBlocks(glm::ivec3 center, float radius, const std::vector<Block::Type> & types, std::function<bool(glm::ivec3)> visit);
+	static ChunckStreamer & Streamer();
+
+
+	static int m_playerAnchor;
+	static uint32_t m_tick;
+
+	//Camera of the last ClipChuncks
+	static bool m_cullValid;
+	static uint32_t m_cullVersion;
+	static glm::vec3 m_cullPosition;
+	static glm::vec3 m_cullForward;
+	static glm::vec3 m_cullUp;
+	static glm::vec3 m_cullRight;
+	static glm::mat4 m_cullProjection;
+	static glm::ivec3 m_cullCell;
+	static uint32_t m_cullConnectivity;
+
+	//Occlusion culling through the subChuncks connectivity
+	static bool m_occlusionCulling;
+	static uint32_t m_visibleMark;
+	static uint32_t m_skyVersion;//Chuncks and connectivity of the last walk from the sky
+	static uint32_t m_skyConnectivity;
+	static int m_frustumCount;
+	static int m_drawnCount;
+
+	//Occlusion culling by the solid boxes rasterized on the CPU
+	static bool m_rasterOcclusion;
+	static OcclusionBuffer m_occlusion;
+	static float m_rasterTime;
+	static int m_rasterCulled;
+	static int m_rasterCulledTriangles;
+
+	//Meshes changes since the shadow maps were rendered, in version order
+	struct MeshChange
+	{
+		uint32_t version;
+		glm::ivec3 subChunck;
+	};
+	static std::deque<MeshChange> m_meshChanges;
+	static uint32_t m_meshVersion;
+
+	//Culling by the GPU
+	static bool m_gpuCulling;
+	static float m_gpuCullingTime;
 };
 
 
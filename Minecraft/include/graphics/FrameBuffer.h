@@ -5,6 +5,7 @@
 #include <glm/glm.hpp> 
 
 #include <iostream>
+#include <vector>
 
 #include "graphics/Texture.h"
 
@@ -79,18 +80,23 @@ public:
 };
 
 //////////////////////////////// ShadowMapFBO ////////////////////////////////
+//Depth texture array, every layer is rendered in the same pass by a geometry shader writing gl_Layer
 class ShadowMapFBO : public FBO
 {
 public:
-	ShadowMapFBO(int width, int height);
+	ShadowMapFBO(int width, int height, int layers = 1);
 	~ShadowMapFBO();
 
 	void Use() const override;
 	void Clear() const override;
+	void ClearLayer(int layer) const;//The others keep their depths
 	void UseTexture(TextureUnit textureUnit)const;
 
+	int Layers() const;
+
 private:
 	unsigned int depthMap;
+	std::vector<unsigned int> m_layerFbos;//One layer attached, to clear it alone
 };
 
 //////////////////////////////// DeferredFBO ////////////////////////////////
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "graphics/Shader.h"
+#include "graphics/MeshArena.h"
+
+//Culling of the mesh arena draws by a compute shader, against the frustum and a hierarchical depth buffer of the previous frame.
+//Each drawn object owns a slot holding its position and allocations, only the slots that changed are uploaded.
+//The compute shader writes one indirect command per slot, the CPU cost of a frame does not depend on the number of slots.
+//Needs OpenGL 4.3 (compute shaders, shader storage buffers and multi-draw indirect).
+class GpuCuller
+{
+public:
+	GpuCuller();
+	~GpuCuller();
+
+	struct Record//Layout of the std430 record of shaders/compute/cull.cs
+	{
+		glm::vec4 position;//xyz: min corner, also the offset of the vertices
+		uint32_t opaqueFirst;
+		uint32_t opaqueCount;
+		uint32_t transparentFirst;
+		uint32_t transparentCount;
+	};
+
+	static bool Supported();
+
+	//Any time, from the main thread. The slot is allocated by the first Set and -1 after Remove
+	void Set(int & slot, const Record & record);
+	void Remove(int & slot);
+
+	//Graphics context thread
+	void Cull(const glm::mat4 & projView, glm::vec3 boxSize);
+	void BuildPyramid(unsigned int depthTexture, int width, int height);//From the depth of the frame culled by the last Cull
+	void DrawOpaque(MeshArena & arena) const;
+	void DrawTransparent(MeshArena & arena) const;
+	void Invalidate();//The next Cull tests the frustum only, when frames were drawn without the culling
+
+	int Slots() const;//In use
+
+private:
+	GpuCuller(const GpuCuller &) = delete;
+	GpuCuller& operator= (const GpuCuller&) = delete;
+
+	struct DrawCommand//Layout of DrawArraysIndirectCommand
+	{
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t first;
+		uint32_t baseInstance;
+	};
+
+	void Init();
+	void Reserve(int capacity);
+
+	bool m_initialized;
+	Shader * m_cullShader;
+	Shader * m_pyramidShader;
+
+	unsigned int m_records;//Also the per instance offsets of the draws
+	unsigned int m_opaqueCommands;
+	unsigned int m_transparentCommands;
+	int m_capacity;//Slots in the buffers
+
+	std::vector<Record> m_slots;
+	std::vector<int> m_freeSlots;
+	int m_dirtyFirst;//Range of slots to upload
+	int m_dirtyLast;
+
+	unsigned int m_pyramid;
+	int m_pyramidWidth;
+	int m_pyramidHeight;
+	int m_pyramidLevels;
+	bool m_pyramidValid;
+	glm::mat4 m_projView;//Of the last Cull
+	glm::mat4 m_pyramidProjView;
+};
@@ -19,21 +19,46 @@ public:
 };
 
 
+//Cascaded shadow maps fitted to slices of the camera frustum, all the cascades are layers of one texture array rendered in a single pass.
+//Each cascade is cached, it is rendered again when its texel snapped origin moves or when a mesh in its volume changes.
+//The farther cascades are updated every 2, 4, 8 frames only.
 class DirectionalLight : public Light
 {
 public:
-	DirectionalLight(glm::vec3 directionLight, float size = 20.f);
+	static const int maxCascades = 4;//Layers of the texture array, also in shadows.gs and light.fs
+	static const int resolution = 2048;
+
+	DirectionalLight(glm::vec3 directionLight, int cascades = 3, float distance = 160.f);
 	virtual ~DirectionalLight();
-	void BakeShadows(glm::vec3 lookPoint);
+	void BakeShadows(const Camera & camera);
+	void Invalidate();//Rendered again by the next BakeShadows
 
-	glm::mat4 ProjectionView();
+	int Cascades() const;
+	void SetCascades(int count);
+	glm::mat4 ProjectionView(int cascade) const;
+	float Bias(int cascade) const;//Depth bias for the size of the cascade texels
+	int BakedCascades() const;//Count rendered by the last BakeShadows
 
 	ShadowMapFBO fbo;
 
 private:
+	struct Cascade
+	{
+		glm::mat4 projection = glm::mat4(1.f);
+		glm::mat4 view = glm::mat4(1.f);
+		glm::vec3 origin = glm::vec3(0.f);//Snapped center of the bounding sphere of the camera frustum slice
+		float radius = 0.f;
+		bool valid = false;
+		int framesSinceBake = 0;
+		uint32_t meshVersion = 0;//World::MeshVersion() when the layer was rendered
+	};
+
 	glm::vec3 direction;
-	const glm::mat4 projection;
-	glm::mat4 view;
+	const glm::mat4 m_rotation;//World to light space, without translation
+	const float m_distance;//Shadows are cast up to this distance from the camera
+	int m_cascadesCount;
+	Cascade m_cascades[maxCascades];
+	int m_baked;//Mask of the cascades rendered by the last BakeShadows
 
 	static Shader * shader;
 
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "graphics/Mesh.h"
+#include "graphics/Shader.h"
+#include "graphics/UploadRing.h"
+
+//Vertices of many meshes suballocated from a single vertex buffer, drawn with one glMultiDrawArraysIndirect per pass.
+//The position of each draw comes from an instanced attribute (location 3) fetched at the draw base instance instead of a model matrix.
+//Without OpenGL 4.3 the draws are issued one by one from the same buffer.
+//Shadow passes use a second vertex array reading only the positions, the normals and texture coordinates are not fetched.
+//Vertices staged by any thread in the persistently mapped ring are copied on the GPU, the main thread never touches them.
+class MeshArena
+{
+public:
+	MeshArena();
+	~MeshArena();
+
+	static const uint32_t initialCapacity = 1 << 20;//Vertices, the buffer doubles when full
+
+	struct Allocation
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;//0 when nothing is allocated
+	};
+
+	struct DrawCall
+	{
+		Allocation allocation;
+		glm::vec3 offset;
+	};
+
+	//Any thread, an empty slice when the vertices cannot be staged
+	UploadRing::Slice Stage(const std::vector<Mesh::Vertex> & vertices);
+	UploadRing::Slice Stage(const Mesh::Vertex * vertices, size_t count);
+
+	//Must be called from the thread owning the graphics context
+	Allocation Allocate(const std::vector<Mesh::Vertex> & vertices);
+	Allocation Allocate(UploadRing::Slice & staged);//Releases the slice
+	void Discard(UploadRing::Slice & staged);
+	void Free(Allocation & allocation);
+	void Draw(const std::vector<DrawCall> & draws, bool depthOnly = false);//Depth only passes fetch the positions alone
+	void DrawIndirect(unsigned int commands, unsigned int offsets, int offsetsStride, int count);//Commands and offsets written on the GPU, OpenGL 4.3
+	void EndFrame();
+
+	size_t Capacity() const;//Bytes
+	size_t Used() const;//Bytes
+	bool Indirect() const;
+
+private:
+	MeshArena(const MeshArena &) = delete;
+	MeshArena& operator= (const MeshArena&) = delete;
+
+	struct DrawCommand//Layout of DrawArraysIndirectCommand
+	{
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t first;
+		uint32_t baseInstance;
+	};
+
+	void Init();
+	Allocation Reserve(uint32_t count);
+	void Grow(uint32_t minCapacity);
+	void SetVertexAttributes();
+
+	bool m_initialized = false;
+	bool m_indirect = false;
+	unsigned int m_VAO = 0;
+	unsigned int m_depthVAO = 0;//Positions and offsets only
+	unsigned int m_VBO = 0;
+	unsigned int m_offsetsVBO = 0;
+	unsigned int m_commandsBuffer = 0;
+
+	uint32_t m_capacity = 0;
+	uint32_t m_used = 0;
+	std::map<uint32_t, uint32_t> m_free;//First vertex -> vertices count of the free ranges, adjacent ranges are merged
+
+	UploadRing m_staging;
+
+	std::vector<DrawCommand> m_commands;
+	std::vector<glm::vec3> m_offsets;
+};
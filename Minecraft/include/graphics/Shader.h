@@ -17,6 +17,8 @@ class Shader
 public:
 
 	Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
+	Shader(const GLchar* vertexPath, const GLchar* geometryPath, const GLchar* fragmentPath);
+	Shader(const GLchar* computePath);//Compute shader program, OpenGL 4.3
 	static void ReloadAll();
 	void Load();
 	void Use() const;
@@ -40,6 +42,10 @@ private:
 	int ID;
 	std::string m_vertexPath;
 	std::string m_fragmentPath;
+	std::string m_geometryPath;
+	std::string m_computePath;
+
+	void LoadCompute();
 
 	static std::vector<Shader *> m_shaders;
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+//Staging buffer persistently mapped for the whole run, any thread writes in it and the main thread copies from it on the GPU.
+//Space is handed out as a ring. A slice is reused once the main thread released it and the fence of the frame that copied it is signaled.
+//Needs OpenGL 4.4 (glBufferStorage), Write fails before Init and on older contexts so the callers keep their own copy of the data.
+class UploadRing
+{
+public:
+	UploadRing();
+	~UploadRing();
+
+	static const size_t defaultCapacity = 32 << 20;//Bytes
+
+	struct Slice
+	{
+		uint64_t id = 0;
+		size_t offset = 0;
+		size_t size = 0;//0 when nothing is staged
+	};
+
+	//Main thread
+	bool Init(size_t capacity = defaultCapacity);
+	void Copy(const Slice & slice, GLenum target, GLintptr offset);//Copies the slice in the buffer bound to target
+	void Release(Slice & slice);
+	void EndFrame();//Fences the copies of the frame and recycles the slices whose copies are done
+
+	//Any thread, fails when the ring is full or not initialized
+	Slice Write(const void * data, size_t size);
+
+	unsigned int Buffer() const;
+	size_t Capacity() const;
+	size_t Used() const;
+
+private:
+	UploadRing(const UploadRing &) = delete;
+	UploadRing& operator= (const UploadRing&) = delete;
+
+	struct Entry
+	{
+		size_t size;//Bytes consumed in the ring, the skipped end of the ring included
+		bool released;
+		uint64_t frame;//Frame of the copy, 0 when never copied
+	};
+
+	struct Fence
+	{
+		GLsync sync;
+		uint64_t frame;
+	};
+
+	void Retire();
+
+	unsigned int m_buffer;
+	uint8_t * m_data;
+	size_t m_capacity;
+
+	std::mutex m_mutex;
+	size_t m_head;//Next byte written
+	size_t m_used;
+	uint64_t m_frontId;//Id of m_entries.front()
+	std::deque<Entry> m_entries;//In ring order
+
+	uint64_t m_frame;
+	bool m_copiedThisFrame;
+	uint64_t m_completedFrame;//Every copy up to this frame is done
+	std::deque<Fence> m_fences;
+};
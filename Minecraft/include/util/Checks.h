@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+//Checks of the parts that can be exercised on synthetic data, run from the command line (Minecraft --check [name]).
+//Each check prints its failures as errors, the exit code is the number of failed checks.
+//Checks needing a graphics context open a hidden window, they are skipped when the context is too old.
+class Checks
+{
+public:
+	static int Main(int argc, char ** argv);//Command line entry point, returns the exit code
+
+	static bool Ring();//"ring": fills the upload ring, wraps it and recycles its slices through the fences
+	static bool Occlusion();//"occlusion": boxes behind, beside and through the near plane of a wall, SSE and scalar rasterizers agree
+	static bool MeshCache();//"meshcache": a saved mesh is staged in the upload ring on load, neither meshed nor uploaded from the vectors
+
+private:
+	static GLFWwindow * CreateContext();//Hidden window, nullptr when no context can be created
+	static bool Expect(bool condition, const std::string & check, const std::string & what);
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//View volume planes extracted from a projection * view matrix (Gribb & Hartmann), normals point inside.
+//Works for perspective and orthographic matrices, the near and far planes included.
+class Frustum
+{
+public:
+	enum Result { outside, intersect, inside };
+	enum PlaneId { leftPlane, rightPlane, bottomPlane, topPlane, nearPlane, farPlane, planesCount };
+
+	Frustum();
+	Frustum(const glm::mat4 & projView, float margin = 0.f);//Planes pushed outward by margin world units
+
+	Result TestBox(glm::vec3 min, glm::vec3 max) const;
+
+	//Column of boxes of cellSize stacked from min along y, bit i set when the box i intersects the frustum. Tests 4 boxes at a time with SSE.
+	uint32_t TestColumn(glm::vec3 min, glm::vec3 cellSize, int cells) const;
+
+	glm::vec4 planes[planesCount];//xyz normal, w distance
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//Read only view of a whole file mapped in memory
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string & path);
+	void Close();
+
+	const uint8_t * Data() const;
+	size_t Size() const;
+
+private:
+	MappedFile(const MappedFile &) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	const uint8_t * m_data;
+	size_t m_size;
+
+#ifdef _WIN32
+	void * m_file;
+	void * m_mapping;
+#else
+	int m_file;
+#endif
+};
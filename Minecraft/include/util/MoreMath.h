@@ -2,6 +2,18 @@
 
 #include <glm/glm.hpp>
 
+//Integer division and modulo rounding toward negative infinity, world coordinates can be negative
+inline int FloorDiv(int value, int divisor)
+{
+	int quotient = value / divisor;
+	return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+inline int FloorMod(int value, int divisor)
+{
+	return value - FloorDiv(value, divisor) * divisor;
+}
+
 class Plane
 {
 public :
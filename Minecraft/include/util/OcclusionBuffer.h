@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//Low resolution depth buffer rasterized on the CPU, no graphics context needed.
+//Occluders are drawn first, then boxes entirely behind them are reported hidden and not submitted to the GPU.
+//Depths are the normalized device z of the occluders at the pixel centers, 4 pixels at a time with SSE.
+//Occluder triangles crossing the near plane are skipped and boxes crossing it are always visible.
+class OcclusionBuffer
+{
+public:
+	static const int width = 256;
+	static const int height = 128;
+
+	OcclusionBuffer();
+
+	void Clear(const glm::mat4 & projView, glm::vec3 eye);
+	void DrawBox(glm::vec3 min, glm::vec3 max);//Occluder, only the faces towards the eye are rasterized
+	void DrawTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2);//Clip space
+	bool TestBox(glm::vec3 min, glm::vec3 max) const;//False when the whole box is behind the occluders
+
+	int Triangles() const;//Occluder triangles rasterized since Clear
+	float Depth(int x, int y) const;
+
+	static bool SimdSupported();
+	void SetSimd(bool state);//Scalar path when false, both give the same depths
+
+private:
+	glm::vec3 ToScreen(glm::vec4 clip) const;
+
+	glm::mat4 m_projView;
+	glm::vec3 m_eye;
+	std::vector<float> m_depths;//width * height, row 0 at the bottom
+	int m_triangles;
+	bool m_simd;
+};
@@ -0,0 +1,97 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+//One record per subchunck slot, one command per slot in each pass, culled slots draw no instance.
+//The base instance of a command selects the position of its record as the offset of the vertices.
+struct Record
+{
+	vec4 position;
+	uint opaqueFirst;
+	uint opaqueCount;
+	uint transparentFirst;
+	uint transparentCount;
+};
+
+struct Command
+{
+	uint count;
+	uint instanceCount;
+	uint first;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Records { Record records[]; };
+layout (std430, binding = 1) writeonly buffer OpaqueCommands { Command opaqueCommands[]; };
+layout (std430, binding = 2) writeonly buffer TransparentCommands { Command transparentCommands[]; };
+
+uniform int recordsCount;
+uniform vec3 size;//Of a subchunck
+uniform vec4 planes[6];//Frustum of the camera, normals inside
+
+uniform bool hiZ;
+uniform mat4 pyramidProjView;//Camera of the frame the pyramid was built from
+uniform sampler2D pyramid;
+uniform int pyramidLevels;
+
+bool InFrustum(vec3 boxMin, vec3 boxMax)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		vec3 positive = mix(boxMin, boxMax, step(0.0, planes[i].xyz));
+		if (dot(planes[i].xyz, positive) + planes[i].w < 0.0)
+			return false;
+	}
+	return true;
+}
+
+bool Occluded(vec3 boxMin, vec3 boxMax)
+{
+	//Screen rectangle and closest depth of the box in the previous frame
+	vec2 rectMin = vec2(1.0);
+	vec2 rectMax = vec2(0.0);
+	float closest = 1.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+		vec4 clip = pyramidProjView * vec4(corner, 1.0);
+		if (clip.w <= 0.0)
+			return false;
+		vec3 ndc = clip.xyz / clip.w;
+		rectMin = min(rectMin, 0.5 * ndc.xy + 0.5);
+		rectMax = max(rectMax, 0.5 * ndc.xy + 0.5);
+		closest = min(closest, 0.5 * ndc.z + 0.5);
+	}
+
+	//Out of the previous screen, nothing is known
+	if (any(lessThan(rectMin, vec2(0.0))) || any(greaterThan(rectMax, vec2(1.0))))
+		return false;
+
+	//Level where the rectangle spans at most 2 texels along each axis
+	vec2 extent = (rectMax - rectMin) * vec2(textureSize(pyramid, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, pyramidLevels - 1);
+	ivec2 levelSize = textureSize(pyramid, level);
+	ivec2 first = clamp(ivec2(rectMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+	ivec2 last = clamp(ivec2(rectMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, texelFetch(pyramid, ivec2(x, y), level).r);
+	return closest > farthest;
+}
+
+void main()
+{
+	int i = int(gl_GlobalInvocationID.x);
+	if (i >= recordsCount)
+		return;
+
+	Record record = records[i];
+	vec3 boxMin = record.position.xyz;
+	vec3 boxMax = boxMin + size;
+	bool visible = record.opaqueCount + record.transparentCount > 0u && InFrustum(boxMin, boxMax) && !(hiZ && Occluded(boxMin, boxMax));
+
+	uint instances = visible ? 1u : 0u;
+	opaqueCommands[i] = Command(record.opaqueCount, instances, record.opaqueFirst, uint(i));
+	transparentCommands[i] = Command(record.transparentCount, instances, record.transparentFirst, uint(i));
+}
@@ -0,0 +1,31 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+//Level 0 copies the depth buffer, every other level keeps the farthest depth of the texels it covers
+layout (r32f, binding = 0) readonly uniform image2D source;
+layout (r32f, binding = 1) writeonly uniform image2D destination;
+uniform sampler2D depth;
+uniform int level;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(destination);
+	if (any(greaterThanEqual(texel, size)))
+		return;
+
+	if (level == 0)
+	{
+		imageStore(destination, texel, vec4(texelFetch(depth, texel, 0).r));
+		return;
+	}
+
+	//The last texel of an odd sized level also covers the extra source row or column
+	ivec2 sourceSize = imageSize(source);
+	ivec2 last = min(2 * texel + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);
+	float farthest = 0.0;
+	for (int y = 2 * texel.y; y <= last.y; ++y)
+		for (int x = 2 * texel.x; x <= last.x; ++x)
+			farthest = max(farthest, imageLoad(source, ivec2(x, y)).r);
+	imageStore(destination, texel, vec4(farthest));
+}
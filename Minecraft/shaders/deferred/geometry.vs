@@ -3,6 +3,7 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec3 aOffset;//Position of the chunck mesh, 0 for models
 
 //Camera matrix
 uniform mat4 model;
@@ -15,8 +16,8 @@ out vec3 normal;
 void main()
 {
 	texCoord = aTexCoord;
-    fragPos = vec3(model * vec4(aPos, 1.0));
+    fragPos = vec3(model * vec4(aPos + aOffset, 1.0));
     normal = mat3(model) * aNormal;
 
-	gl_Position = projview * model * vec4(aPos, 1.0);
+	gl_Position = projview * model * vec4(aPos + aOffset, 1.0);
 }
\ No newline at end of file
@@ -7,16 +7,17 @@ out vec4 FragColor;
 uniform sampler2D gColor;
 uniform sampler2D gNormal;
 uniform sampler2D gPosition;
-uniform sampler2D shadowMap;
-uniform sampler2D shadowMapLarge;
+uniform sampler2DArray shadowMaps;//One layer per cascade
 uniform sampler2D ambientOcclusion;
 
 uniform vec3 viewPos;
 uniform vec3 lightDir;
 uniform vec3 lightColor;
 
-uniform mat4 projectionViewLight;
-uniform mat4 projectionViewLightLarge;
+const int maxCascades = 4;//DirectionalLight::maxCascades
+uniform int cascadesCount;
+uniform mat4 projectionViewLights[maxCascades];
+uniform float shadowBiases[maxCascades];
 
 vec4 color = texture(gColor, TexCoords);
 vec3 fragPos = texture(gPosition, TexCoords).xyz;
@@ -24,7 +25,7 @@ vec3 normal = texture(gNormal, TexCoords).xyz;
 
 vec3 viewDir = normalize(viewPos - fragPos);
 
-float ShadowCalculation(vec3 frag, sampler2D map, float threshold);
+float ShadowCalculation(vec3 frag, int cascade, float threshold);
 float blurredAmbientOcclusion();
 
 void main()
@@ -36,13 +37,16 @@ void main()
 
 	float shadow = 1;
 
-	vec4 fragPosLightSpace = projectionViewLight * vec4(fragPos,1);
-	vec4 fragPosLightSpaceLarge = projectionViewLightLarge * vec4(fragPos,1);
-
-	if( fragPosLightSpace.x < 1.f && fragPosLightSpace.x > -1.f && fragPosLightSpace.y < 1.f && fragPosLightSpace.y > -1.f)
-		shadow = ShadowCalculation(fragPosLightSpace.xyz, shadowMap, 0.00015f);  
-	else if (fragPosLightSpaceLarge.x <= 1.f && fragPosLightSpaceLarge.x >= -1.f && fragPosLightSpaceLarge.y <= 1.f && fragPosLightSpaceLarge.y >= -1.f)
-		shadow = ShadowCalculation(fragPosLightSpaceLarge.xyz, shadowMapLarge, 0.0005f);  
+	//The first cascade covering the fragment is the sharpest
+	for (int cascade = 0; cascade < cascadesCount; ++cascade)
+	{
+		vec4 fragPosLightSpace = projectionViewLights[cascade] * vec4(fragPos,1);
+		if (fragPosLightSpace.x < 1.f && fragPosLightSpace.x > -1.f && fragPosLightSpace.y < 1.f && fragPosLightSpace.y > -1.f)
+		{
+			shadow = ShadowCalculation(fragPosLightSpace.xyz, cascade, shadowBiases[cascade]);
+			break;
+		}
+	}
 
 	FragColor =  vec4( occlusion*( ambient +  (shadow*0.8 + 0.2) * diffuse + shadow * spec) * color.xyz  * lightColor , color.w  );
 
@@ -77,10 +81,10 @@ float blurredAmbientOcclusion()
 	return occlusion;
 }
 
-float ShadowCalculation(vec3 frag, sampler2D map, float threshold)
+float ShadowCalculation(vec3 frag, int cascade, float threshold)
 {
     frag = frag * 0.5 + 0.5;
-	vec2 texelSize = 1.0 / textureSize(map, 0);
+	vec2 texelSize = 1.0 / textureSize(shadowMaps, 0).xy;
 	float bias = max(threshold * (1.0 - dot(normal, lightDir)), threshold);  
     float currentDepth = frag.z; 
 
@@ -88,7 +92,7 @@ float ShadowCalculation(vec3 frag, sampler2D map, float threshold)
 	for( int x = -1; x <= 1; ++x)
 		for( int y = -1; y <= 1; ++y)
 		{
-			float depth = texture(map, vec2(frag.x + x * texelSize.x, frag.y + y + texelSize.y)).r;
+			float depth = texture(shadowMaps, vec3(frag.x + x * texelSize.x, frag.y + y * texelSize.y, cascade)).r;
 			shadow += currentDepth - bias > depth ? 1.0 : 0.0;  
 		}
 	shadow /= 3*3;
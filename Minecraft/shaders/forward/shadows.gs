@@ -0,0 +1,34 @@
+#version 330 core
+const int maxCascades = 4;//DirectionalLight::maxCascades
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 12) out;
+
+uniform mat4 projviews[maxCascades];
+uniform int cascadesMask;//Layers rendered in this pass
+
+void main()
+{
+	for (int cascade = 0; cascade < maxCascades; ++cascade)
+	{
+		if ((cascadesMask & (1 << cascade)) == 0)
+			continue;
+
+		vec4 clip[3];
+		for (int i = 0; i < 3; ++i)
+			clip[i] = projviews[cascade] * gl_in[i].gl_Position;
+
+		//Triangles entirely on the outer side of a border of the cascade are not sent to its layer
+		if ((clip[0].x > 1.0 && clip[1].x > 1.0 && clip[2].x > 1.0) || (clip[0].x < -1.0 && clip[1].x < -1.0 && clip[2].x < -1.0) ||
+			(clip[0].y > 1.0 && clip[1].y > 1.0 && clip[2].y > 1.0) || (clip[0].y < -1.0 && clip[1].y < -1.0 && clip[2].y < -1.0))
+			continue;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			gl_Layer = cascade;
+			gl_Position = clip[i];
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
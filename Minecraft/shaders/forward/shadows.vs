@@ -1,10 +1,11 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec3 aOffset;//Position of the chunck mesh, 0 for models
 
 uniform mat4 model;
-uniform mat4 projview;
 
+//World position, projected in each cascade by the geometry shader
 void main()
 {
-	gl_Position = projview * model * vec4(aPos, 1.0);
-} 
\ No newline at end of file
+	gl_Position = model * vec4(aPos + aOffset, 1.0);
+} 
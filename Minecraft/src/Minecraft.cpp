@@ -82,8 +82,7 @@ void Minecraft::Start()
 	PostProcessingFBO fboPostProcTransparent(m_width, m_height);
 
 	glm::vec3 sunDir = glm::normalize(glm::vec3(4, -4, 1));
-	DirectionalLight sunLight(sunDir, 20.f);
-	DirectionalLight sunLightLarge(sunDir, 100.f);
+	DirectionalLight sunLight(sunDir, 3, 160.f);
 
 	Tiles::Initialize(4, 4);
 	TexturesBlocks::Initialize();
@@ -103,7 +102,7 @@ void Minecraft::Start()
 	SetupFXAA();
 
 	glm::mat4 textProjection = glm::ortho(0.0f, static_cast<GLfloat>(m_width), 0.0f, static_cast<GLfloat>(m_height));
-	glm::vec3 startPos((World::GetOrigin().x + World::size / 2) * SubChunck::size, Chunck::height * SubChunck::size, (World::GetOrigin().x + World::size / 2) * SubChunck::size);
+	glm::vec3 startPos((World::GetOrigin().x + World::Size() / 2) * SubChunck::size, Chunck::height * SubChunck::size, (World::GetOrigin().x + World::Size() / 2) * SubChunck::size);
 	//startPos -= glm::vec3(5, 25, 5);
 	
 	PlayerAvatar player;
@@ -111,6 +110,8 @@ void Minecraft::Start()
 
 	Cube cube;
 	cube.rb().translate(bt::toVec3(startPos));
+	int cubeAnchor = World::AddAnchor(World::ChunckAt(cube.rb().Position()), World::physicsAnchorSize);
+	int spectatorAnchor = -1;
 
 	FreeCameraController freeCameraController( glm::vec2(m_width, m_height) );
 	freeCameraController.SetEnabled(false);
@@ -140,6 +141,11 @@ void Minecraft::Start()
 	bool multisample = true;
 	bool viewFrustumCulling = true;
 	bool vSync = true;
+	int viewDistance = World::Size();
+	ViewDistanceController viewDistanceController;
+	float editsPerSecond = 0.f;
+	const float queryRadii[4] = { 8.f, 16.f, 32.f, 64.f };
+	float queryTimes[4][2] = {};//Indexed, block by block
 
 	//Imgui data
 	std::stringstream ssItems;
@@ -173,12 +179,15 @@ void Minecraft::Start()
 					freeCameraController.SetEnabled(false);
 					playerController.SetEnabled(true);
 					usedCamera = &playerController.GetCamera();
+					World::RemoveAnchor(spectatorAnchor);
+					spectatorAnchor = -1;
 				}
 				else
 				{
 					freeCameraController.SetEnabled(true);
 					playerController.SetEnabled(false);
 					usedCamera = &freeCameraController.GetCamera();
+					spectatorAnchor = World::AddAnchor(World::ChunckAt(freeCameraController.GetCamera().position()), World::spectatorAnchorSize);
 				}
 				shader_debug.Use();
 				shader_debug.setMat4("projection", usedCamera->projectionMatrix());
@@ -202,8 +211,11 @@ void Minecraft::Start()
 
 			Physics::StepSimulation(fixedUpdateTimer);
 
-			World::CenterChuncksAround(player.rb().Position() / (float)SubChunck::size);
-			//World::CenterChuncksAround(freeCameraController.GetCamera().position() / (float) SubChunck::size);
+			World::CenterChuncksAround(World::ChunckAt(player.rb().Position()));
+			World::PrefetchChuncks(player.rb().Position(), glm::toVec3(player.rb().getLinearVelocity()), usedCamera->forward());
+			World::MoveAnchor(cubeAnchor, World::ChunckAt(cube.rb().Position()));
+			if (spectatorAnchor >= 0)
+				World::MoveAnchor(spectatorAnchor, World::ChunckAt(freeCameraController.GetCamera().position()));
 
 			freeCameraController.Update(fixedUpdateTimer);
 			playerController.selectedBlock = (playerController.selectedBlock + Mouse::DeltaScroll().y + Block::count - 1) % (Block::count - 1);
@@ -221,6 +233,7 @@ void Minecraft::Start()
 		if (drawTimer >= Time::DeltaTime() || !vSync)
 		{
 			drawTimer = 0.f;
+			float frameStart = Time::ElapsedSinceStartup();
 
 			//Fps count
 			++frameCount;
@@ -232,13 +245,14 @@ void Minecraft::Start()
 			}
 
 
-			if (viewFrustumCulling)
+			if (World::GpuCullingEnabled())
+				World::CullOnGpu(*usedCamera);
+			else if (viewFrustumCulling)
 				World::ClipChuncks(playerController.GetCamera());
 
 
 			//////////////////////////////// BAKE SHADOWS ////////////////////////////////
-			sunLight.BakeShadows(player.rb().Position());
-			sunLightLarge.BakeShadows(player.rb().Position());
+			sunLight.BakeShadows(*usedCamera);
 
 			//////////////////////////////// DEFERRED GEOMETRY ////////////////////////////////
 			shader_deferred_geometry.Use();
@@ -256,6 +270,7 @@ void Minecraft::Start()
 			cube.Draw(shader_deferred_geometry);
 
 			World::DrawOpaque(shader_deferred_geometry);
+			World::BuildDepthPyramid(gBuffer.gDepth, m_width, m_height);
 
 			//////////////////////////////// SSAO ////////////////////////////////
 			fboSSAO.Use();
@@ -287,23 +302,25 @@ void Minecraft::Start()
 			gBuffer.UseNormal(TextureUnit::Unit1);
 			gBuffer.UsePosition(TextureUnit::Unit2);
 			sunLight.fbo.UseTexture(TextureUnit::Unit3);
-			sunLightLarge.fbo.UseTexture(TextureUnit::Unit4);
 			fboSSAO.UseTexture(TextureUnit::Unit5);
 
 			shader_deferred_light.Use();
 			shader_deferred_light.setInt("gColor", 0);
 			shader_deferred_light.setInt("gNormal", 1);
 			shader_deferred_light.setInt("gPosition", 2);
-			shader_deferred_light.setInt("shadowMap", 3);
-			shader_deferred_light.setInt("shadowMapLarge", 4);
+			shader_deferred_light.setInt("shadowMaps", 3);
 			shader_deferred_light.setInt("ambientOcclusion", 5);
 			shader_deferred_light.setVec3("lightDir", -sunDir);
 			shader_deferred_light.setVec3("viewPos", usedCamera->position());
 			shader_deferred_light.setVec3("lightColor", glm::vec3(255 / 255.f, 255 / 255.f, 255.f / 255.f));
 
 
-			shader_deferred_light.setMat4("projectionViewLight", sunLight.ProjectionView());
-			shader_deferred_light.setMat4("projectionViewLightLarge", sunLightLarge.ProjectionView());
+			shader_deferred_light.setInt("cascadesCount", sunLight.Cascades());
+			for (int cascade = 0; cascade < sunLight.Cascades(); ++cascade)
+			{
+				shader_deferred_light.setMat4("projectionViewLights[" + std::to_string(cascade) + "]", sunLight.ProjectionView(cascade));
+				shader_deferred_light.setFloat("shadowBiases[" + std::to_string(cascade) + "]", sunLight.Bias(cascade));
+			}
 
 			glDisable(GL_DEPTH_TEST);
 			glBindVertexArray(postProcVAO);
@@ -415,11 +432,41 @@ void Minecraft::Start()
 			ImGui::Begin("Performance");
 			ImGui::BulletText(" %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			ImGui::BulletText(" %.1ik triangles", Statistics::GetTriangles() / 1000);
+			ImGui::BulletText(" %i chuncks resident (view distance %i)", World::ResidentChuncksCount(), World::Size());
+			ImGui::BulletText(" %i generations pending", World::GeneratorBacklog());
+			ImGui::BulletText(" %.3f ms/subchunck mesh (%s layout)", 1000.f * World::MeshTime(), SubChunck::MortonLayout() ? "morton" : "linear");
+			ImGui::BulletText(" %.3f ms/chunck generated, %.3f ms/chunck loaded", 1000.f * World::ChunckGenerationTime(), 1000.f * World::ChunckLoadTime());
+			ImGui::BulletText(" %i subchuncks updated", World::ActiveSubChuncksCount());
+			if (World::GpuCullingEnabled())
+				ImGui::BulletText(" %.3f ms GPU culling submission, %i subchuncks records", 1000.f * World::GpuCullingTime(), World::GpuCullingRecords());
+			else
+			{
+				ImGui::BulletText(" %i/%i subchuncks drawn (%s occlusion culling)", World::DrawnSubChuncksCount(), World::FrustumSubChuncksCount(), World::OcclusionCullingEnabled() ? "with" : "without");
+				if (World::RasterOcclusionEnabled())
+					ImGui::BulletText(" %.3f ms raster occlusion, %i occluder triangles, %i subchuncks (%.1fk triangles) culled", 1000.f * World::RasterOcclusionTime(), World::RasterOccluderTriangles(), World::RasterCulledCount(), World::RasterCulledTriangles() / 1000.f);
+			}
+			ImGui::BulletText(" %i chuncks cached (%.1f/%.0f MB)", World::CachedChuncksCount(), World::CacheSize(), World::CacheCapacity());
+			if (World::MeshCacheEnabled())
+				ImGui::BulletText(" %.0f%% meshes from disk (%.2f s saved)", 100.f * World::MeshCacheHitRate(), World::MeshCacheTimeSaved());
+			ImGui::BulletText(" %i/%i shadow cascades rendered", sunLight.BakedCascades(), sunLight.Cascades());
+			ImGui::BulletText(" %.1f/%.0f MB chunck vertices (%s)", World::MeshArenaUsed(), World::MeshArenaCapacity(), World::MeshArenaIndirect() ? "multi-draw indirect" : "one draw per subchunck");
 			ImGui::End();
 
 			//BLOCKS
 			ImGui::Begin("Blocks");
 			ImGui::Combo("Block", &playerController.selectedBlock, ssItems.str().data(), Block::count-2);
+			if (ImGui::Button("Edit storm"))
+				editsPerSecond = World::EditStorm(World::BlockAt(player.rb().Position()), 100000);
+			ImGui::SameLine();
+			ImGui::Text("%.0f edits/s", editsPerSecond);
+			if (ImGui::Button("Query benchmark"))
+				for (int i = 0; i < 4; ++i)
+				{
+					queryTimes[i][0] = World::FindBlocksBenchmark(World::BlockAt(player.rb().Position()), queryRadii[i], true);
+					queryTimes[i][1] = World::FindBlocksBenchmark(World::BlockAt(player.rb().Position()), queryRadii[i], false);
+				}
+			for (int i = 0; i < 4; ++i)
+				ImGui::Text("radius %.0f: %.3f ms indexed, %.3f ms block by block", queryRadii[i], 1000.f * queryTimes[i][0], 1000.f * queryTimes[i][1]);
 			ImGui::End();
 
 			//GRAPHICS
@@ -442,6 +489,45 @@ void Minecraft::Start()
 					ImGui::Checkbox("View frustum culling", &viewFrustumCulling);
 					if (oldValueviewFrustumCulling != viewFrustumCulling && !viewFrustumCulling)
 						World::EnableAllChuncks();
+
+					//View distance
+					bool autoViewDistance = viewDistanceController.Enabled();
+					ImGui::Checkbox("Auto view distance", &autoViewDistance);
+					viewDistanceController.SetEnabled(autoViewDistance);
+					if (autoViewDistance)
+					{
+						ImGui::SliderFloat("Target frame time (s)", &viewDistanceController.targetFrameTime, 1.f / 240.f, 1.f / 20.f, "%.4f");
+						viewDistance = World::Size();
+						ImGui::Text("View distance %i (%.2f ms/frame)", viewDistance, 1000.f * viewDistanceController.AverageFrameTime());
+					}
+					else if (ImGui::SliderInt("View distance", &viewDistance, World::minSize, World::maxSize))
+						World::SetSize(viewDistance);
+
+					//Evicted chuncks cache
+					float cacheCapacity = World::CacheCapacity();
+					if (ImGui::SliderFloat("Chuncks cache (MB)", &cacheCapacity, 0.f, 512.f, "%.0f"))
+						World::SetCacheCapacity(cacheCapacity);
+
+					//Meshes saved on disk
+					bool meshCache = World::MeshCacheEnabled();
+					if (ImGui::Checkbox("Mesh cache", &meshCache))
+						World::SetMeshCacheEnabled(meshCache);
+
+					//Caves and buried subchuncks hidden by the subchuncks connectivity
+					bool occlusionCulling = World::OcclusionCullingEnabled();
+					if (ImGui::Checkbox("Occlusion culling", &occlusionCulling))
+						World::SetOcclusionCullingEnabled(occlusionCulling);
+					bool rasterOcclusion = World::RasterOcclusionEnabled();
+					if (ImGui::Checkbox("Raster occlusion culling", &rasterOcclusion))
+						World::SetRasterOcclusionEnabled(rasterOcclusion);
+					bool gpuCulling = World::GpuCullingEnabled();
+					if (World::GpuCullingSupported() && ImGui::Checkbox("GPU culling", &gpuCulling))
+						World::SetGpuCullingEnabled(gpuCulling);
+
+					//Shadows
+					int cascades = sunLight.Cascades();
+					if (ImGui::SliderInt("Shadow cascades", &cascades, 1, DirectionalLight::maxCascades))
+						sunLight.SetCascades(cascades);
 				}
 
 				if (ImGui::CollapsingHeader("OpenGl", ImGuiTreeNodeFlags_DefaultOpen))
@@ -457,6 +543,8 @@ void Minecraft::Start()
 			/////////////////////////////// DRAW ////////////////////////////////
 			glfwSwapBuffers(m_window);
 			Debug::Clear();
+
+			viewDistanceController.Update(Time::ElapsedSinceStartup() - frameStart);
 		}
 	}
 
@@ -139,5 +139,10 @@ std::vector<Plane> Camera::GetFrustrumPlanes() const
 	return { rightPlane, leftPlane, topPlane, botPlane, farPlane };
 }
 
+Frustum Camera::GetFrustum(float margin) const
+{
+	return Frustum(projectionMatrix() * viewMatrix(), margin);
+}
+
 
 
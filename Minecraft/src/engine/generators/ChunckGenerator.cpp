@@ -1,6 +1,13 @@
 #include  "engine/generators/ChunckGenerator.h"
 
-ChunckGenerator::ChunckGenerator() : 
+#include <algorithm>
+
+ChunckGenerator::ChunckGenerator(ChunckPool * chunckPool, const std::string & meshDirectory) : 
+	m_meshTime(0.f),
+	m_blocksTime(0.f),
+	m_meshRounds(0),
+	m_chunckPool(chunckPool),
+	m_meshCache(meshDirectory),
 	m_chuncksGenBlocks(cmpChuncksGen),
 	m_chuncksGenMesh(cmpMeshGen)
 {
@@ -25,23 +32,85 @@ std::vector<SubChunck *>  ChunckGenerator::PopMeshGenerateds()
 	std::vector <SubChunck *> chuncks;
 	m_chuncksMeshGeneratedsMtx.lock();
 	for (SubChunck * chunck : m_chuncksMeshGenerateds)
-	{
 		chuncks.push_back(chunck);
-		chunck->generating = false;
-	}
 	m_chuncksMeshGenerateds.clear();
 	m_chuncksMeshGeneratedsMtx.unlock();
 	return chuncks;
 }
 
+void ChunckGenerator::CancelBlocks()
+{
+	m_chuncksGenBlocksMtx.lock();
+	while (!m_chuncksGenBlocks.empty())
+		m_chuncksGenBlocks.pop();
+	m_chuncksGenBlocksMtx.unlock();
+}
+
+void ChunckGenerator::CancelMeshes(std::function<bool(SubChunck *)> cancel)
+{
+	std::vector<std::pair<SubChunck *, float>> kept;
+
+	m_chuncksGenMeshMtx.lock();
+	while (!m_chuncksGenMesh.empty())
+	{
+		std::pair<SubChunck *, float> request = m_chuncksGenMesh.top();
+		m_chuncksGenMesh.pop();
+		if (cancel(request.first))
+			request.first->generating = false;
+		else
+			kept.push_back(request);
+	}
+	for (std::pair<SubChunck *, float> request : kept)
+		m_chuncksGenMesh.push(request);
+	m_chuncksGenMeshMtx.unlock();
+}
+
+int ChunckGenerator::BlocksBacklog()
+{
+	m_chuncksGenBlocksMtx.lock();
+	int backlog = (int)m_chuncksGenBlocks.size();
+	m_chuncksGenBlocksMtx.unlock();
+	return backlog;
+}
+
+int ChunckGenerator::MeshBacklog()
+{
+	m_chuncksGenMeshMtx.lock();
+	int backlog = (int)m_chuncksGenMesh.size();
+	m_chuncksGenMeshMtx.unlock();
+	return backlog;
+}
+
+float ChunckGenerator::MeshTime() const
+{
+	return m_meshTime;
+}
+
+float ChunckGenerator::BlocksTime() const
+{
+	return m_blocksTime;
+}
+
+uint64_t ChunckGenerator::MeshRounds() const
+{
+	return m_meshRounds;
+}
+
+MeshCache & ChunckGenerator::Meshes()
+{
+	return m_meshCache;
+}
+
 void ChunckGenerator::UpdateBlocks()
 {
 	while ( !m_quitting )
 	{
 		//Get the Blocks positions
 		std::vector <glm::ivec2> positions;
+		std::function<bool(Chunck *)> load;
 
 		m_chuncksGenBlocksMtx.lock();
+		load = m_load;
 		if (!m_chuncksGenBlocks.empty())
 		{
 			//m_meshGenerationPaused = true;
@@ -63,8 +132,19 @@ void ChunckGenerator::UpdateBlocks()
 		std::vector <Chunck *> chuncks;
 		for (glm::ivec2 vec2 : positions)
 		{
-			Chunck * newChunck = new Chunck(vec2.x, vec2.y);
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			Chunck * newChunck = m_chunckPool->Acquire(vec2.x, vec2.y);
+
+			//Saved chuncks are decoded here and not by the main thread, they come back complete
+			if (load && load(newChunck))
+			{
+				chuncks.push_back(newChunck);
+				continue;
+			}
+
 			newChunck->GenerateBlocks();
+			float time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+			m_blocksTime = 0.95f * m_blocksTime + 0.05f * time;
 			chuncks.push_back(newChunck);
 		}
 		//Returns the chuncks
@@ -100,13 +180,44 @@ void ChunckGenerator::UpdateMesh()
 		}
 		//Generates the meshs
 		for (SubChunck * chunck : chuncks)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+			//Faces linked through the subChunck, for the occlusion culling
+			chunck->ComputeConnectivity();
+
+			//The saved mesh is used while the blocks it was made from did not change
+			bool cachable = m_meshCache.Enabled() && chunck->HasFaces();
+			uint64_t hash = cachable ? chunck->ContentHash() : 0;
+			float savedMeshTime = 0.f;
+			if (cachable && m_meshCache.Load(chunck, hash, savedMeshTime))
+			{
+				//Against the meshing of this subChunck when it was saved, the load already staged the vertices
+				float time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+				m_meshCache.AddTimeSaved(std::max(savedMeshTime - time, 0.f));
+				continue;
+			}
+
+			std::chrono::high_resolution_clock::time_point meshStart = std::chrono::high_resolution_clock::now();
 			chunck->GenerateMesh();
+			std::chrono::high_resolution_clock::time_point meshEnd = std::chrono::high_resolution_clock::now();
+			float time = std::chrono::duration<float>(meshEnd - start).count();
+			m_meshTime = 0.95f * m_meshTime + 0.05f * time;
+			if (cachable)
+				m_meshCache.Save(chunck, hash, std::chrono::duration<float>(meshEnd - meshStart).count());
+
+			//The main thread only queues the copy to the mesh arena
+			chunck->StageMesh();
+		}
 
 		//Returns the chuncks
 		m_chuncksMeshGeneratedsMtx.lock();
 		for (SubChunck * chunck : chuncks)
 			m_chuncksMeshGenerateds.push_back(chunck);
 		m_chuncksMeshGeneratedsMtx.unlock();
+
+		//No neighbour block read by this batch is used past this point
+		++m_meshRounds;
 	}
 }
 
@@ -118,6 +229,13 @@ void ChunckGenerator::GenerateBlocks(int  x, int z, float priority )
 }
 
 
+void ChunckGenerator::SetLoader(std::function<bool(Chunck *)> load)
+{
+	m_chuncksGenBlocksMtx.lock();
+	m_load = load;
+	m_chuncksGenBlocksMtx.unlock();
+}
+
 void ChunckGenerator::GenerateMesh( SubChunck * chunck, float priority)
 {
 	if ( ! chunck->generating)
@@ -0,0 +1,109 @@
+#include "engine/generators/LayoutBenchmark.h"
+
+LayoutBenchmark::LayoutBenchmark(int size, int runs) :
+	m_size(size),
+	m_runs(runs),
+	m_pool(0)
+{
+}
+
+int LayoutBenchmark::Main(int argc, char ** argv)
+{
+	int size = argc > 2 ? std::atoi(argv[2]) : 8;
+	int runs = argc > 3 ? std::atoi(argv[3]) : 5;
+	if (size < 1 || runs < 1)
+	{
+		std::cerr << "ERROR: LayoutBenchmark::Main usage: " << argv[0] << " --layout-benchmark [size] [runs]" << std::endl;
+		return 1;
+	}
+
+	LayoutBenchmark benchmark(size, runs);
+	const Result results[2] = { benchmark.Run(false), benchmark.Run(true) };
+	const char * names[2] = { "linear", "morton" };
+
+	std::cout << "Blocks layouts on " << size * size << " chuncks, " << runs << " runs" << std::endl;
+	for (int i = 0; i < 2; ++i)
+	{
+		std::cout << "  " << names[i] << ": blocks " << results[i].blocks << " ms/chunck, mesh " << results[i].mesh << " ms/subchunck, connectivity " << results[i].connectivity;
+		std::cout << " ms/subchunck, compress " << results[i].compress << " ms/subchunck (" << results[i].vertices << " vertices)" << std::endl;
+	}
+	std::cout << "  morton/linear: blocks " << results[1].blocks / results[0].blocks << ", mesh " << results[1].mesh / results[0].mesh;
+	std::cout << ", connectivity " << results[1].connectivity / results[0].connectivity << ", compress " << results[1].compress / results[0].compress << std::endl;
+	if (results[0].vertices != results[1].vertices)
+		std::cerr << "ERROR: LayoutBenchmark::Main the layouts meshed different terrains" << std::endl;
+	return 0;
+}
+
+template <typename Pass>
+float LayoutBenchmark::Time(const std::vector<SubChunck*> & subChuncks, Pass pass)
+{
+	for (SubChunck * subChunck : subChuncks)
+		pass(subChunck);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < m_runs; ++run)
+		for (SubChunck * subChunck : subChuncks)
+			pass(subChunck);
+	return 1000.f * std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count() / (m_runs * subChuncks.size());
+}
+
+LayoutBenchmark::Result LayoutBenchmark::Run(bool morton)
+{
+	//No block is stored yet, the chuncks of the previous run were released
+	SubChunck::SetMortonLayout(morton);
+	Result result = {};
+
+	//The border chuncks receive the trees of the inner ones and close their meshes
+	const int width = m_size + 2;
+	std::vector<Chunck*> chuncks(width * width);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int x = 0; x < width; ++x)
+		for (int z = 0; z < width; ++z)
+		{
+			Chunck * chunck = m_pool.Acquire(x - 1, z - 1);
+			chunck->GenerateBlocks();
+			chuncks[x * width + z] = chunck;
+			if (x > 0)
+			{
+				chunck->SetNeighbour(SubChunck::left, chuncks[(x - 1) * width + z]);
+				chuncks[(x - 1) * width + z]->SetNeighbour(SubChunck::right, chunck);
+			}
+			if (z > 0)
+			{
+				chunck->SetNeighbour(SubChunck::back, chuncks[x * width + z - 1]);
+				chuncks[x * width + z - 1]->SetNeighbour(SubChunck::front, chunck);
+			}
+		}
+
+	std::vector<SubChunck*> subChuncks;
+	std::vector<SubChunck*> spilled;
+	for (int x = 1; x <= m_size; ++x)
+		for (int z = 1; z <= m_size; ++z)
+		{
+			chuncks[x * width + z]->LateGenerateBlocks(spilled);
+			for (int y = 0; y < Chunck::height; ++y)
+				subChuncks.push_back(chuncks[x * width + z]->GetSubChunck(y));
+		}
+	result.blocks = 1000.f * std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count() / (width * width);
+
+	//The vertices are dropped after each meshing, the game moves them to the mesh arena
+	result.mesh = Time(subChuncks, [](SubChunck * subChunck)
+	{
+		subChunck->m_verticesOpaque.clear();
+		subChunck->m_verticesTransparent.clear();
+		subChunck->GenerateMesh();
+	});
+	for (SubChunck * subChunck : subChuncks)
+		result.vertices += subChunck->m_verticesOpaque.size() + subChunck->m_verticesTransparent.size();
+	result.connectivity = Time(subChuncks, [](SubChunck * subChunck) { subChunck->ComputeConnectivity(); });
+	std::vector<uint8_t> data;
+	result.compress = Time(subChuncks, [&data](SubChunck * subChunck)
+	{
+		data.clear();
+		subChunck->Compress(data);
+	});
+
+	for (Chunck * chunck : chuncks)
+		m_pool.Release(chunck);
+	return result;
+}
@@ -0,0 +1,206 @@
+#include "engine/generators/Pregenerator.h"
+
+Pregenerator::Pregenerator(const std::string & directory, int threads, bool saveMeshes) :
+	m_threads(std::max(threads, 1)),
+	m_x0(0),
+	m_x1(0),
+	m_pool(0),
+	m_regions(directory),
+	m_meshes(directory + "/meshes"),
+	m_saved(0),
+	m_skipped(0),
+	m_bytes(0)
+{
+	m_meshes.SetEnabled(saveMeshes);
+}
+
+int Pregenerator::Main(int argc, char ** argv)
+{
+	if (argc < 6)
+	{
+		std::cerr << "ERROR: Pregenerator::Main usage: " << argv[0] << " --pregenerate x0 z0 x1 z1 [threads] [--meshes]" << std::endl;
+		return 1;
+	}
+
+	int x0 = std::atoi(argv[2]);
+	int z0 = std::atoi(argv[3]);
+	int x1 = std::atoi(argv[4]);
+	int z1 = std::atoi(argv[5]);
+	int threads = (int)std::thread::hardware_concurrency();
+	bool saveMeshes = false;
+	for (int i = 6; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--meshes")
+			saveMeshes = true;
+		else
+			threads = std::atoi(argv[i]);
+	}
+
+	Pregenerator pregenerator("world", threads, saveMeshes);
+	pregenerator.Generate(std::min(x0, x1), std::min(z0, z1), std::max(x0, x1), std::max(z0, z1));
+
+	int chuncks = pregenerator.Saved() + pregenerator.Skipped();
+	std::cout << "Pregenerated " << chuncks << " chuncks in " << pregenerator.Time() << " s on " << threads << " threads" << std::endl;
+	std::cout << "  " << chuncks / std::max(pregenerator.Time(), 1e-6f) << " chuncks/sec" << std::endl;
+	std::cout << "  " << pregenerator.Bytes() / std::max(pregenerator.Saved(), 1) << " bytes/chunck (" << pregenerator.Saved() << " saved, " << pregenerator.Skipped() << " already saved)" << std::endl;
+	std::cout << "  blocks " << pregenerator.BlocksTime() << " s, trees " << pregenerator.TreesTime() << " s, meshes " << pregenerator.MeshTime() << " s" << std::endl;
+	return 0;
+}
+
+void Pregenerator::ParallelFor(int count, std::function<void(int)> task)
+{
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < std::min(m_threads, count); ++i)
+		workers.push_back(std::thread([&]()
+		{
+			for (int index = next++; index < count; index = next++)
+				task(index);
+		}));
+	for (std::thread & worker : workers)
+		worker.join();
+}
+
+void Pregenerator::Generate(int x0, int z0, int x1, int z1)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_x0 = x0;
+	m_x1 = x1;
+
+	//Rows z - 3 to z, the trees of a row reach the rows next to it
+	std::deque<Row> rows;
+	for (int z = z0 - 1; z <= z1 + 1; ++z)
+	{
+		rows.push_back(GenerateRow(z, rows.empty() ? nullptr : &rows.back()));
+
+		//Every row around the previous one is generated, its trees can be placed
+		if (z - 1 >= z0)
+			LateGenerateRow(rows[rows.size() - 2]);
+
+		//The trees around the row z - 2 are placed, its blocks are final
+		if (z - 2 >= z0)
+			CompleteRow(rows[rows.size() - 3]);
+
+		if (rows.size() > 3)
+		{
+			ReleaseRow(rows.front());
+			rows.pop_front();
+		}
+	}
+
+	//The last row is the border
+	CompleteRow(rows[rows.size() - 2]);
+	for (Row & row : rows)
+		ReleaseRow(row);
+
+	m_regions.Flush();
+	m_meshes.Flush();
+	m_time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Pregenerator::Row Pregenerator::GenerateRow(int z, Row * previous)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Row row(m_x1 - m_x0 + 3);
+	for (int i = 0; i < (int)row.size(); ++i)
+		row[i] = m_pool.Acquire(m_x0 - 1 + i, z);
+
+	ParallelFor((int)row.size(), [&row](int i) { row[i]->GenerateBlocks(); });
+
+	//Same links as in the world, trees and meshes walk them
+	for (int i = 0; i < (int)row.size(); ++i)
+	{
+		if (i > 0)
+		{
+			row[i]->SetNeighbour(SubChunck::left, row[i - 1]);
+			row[i - 1]->SetNeighbour(SubChunck::right, row[i]);
+		}
+		if (previous)
+		{
+			row[i]->SetNeighbour(SubChunck::back, (*previous)[i]);
+			(*previous)[i]->SetNeighbour(SubChunck::front, row[i]);
+		}
+	}
+
+	m_blocksTime += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+	return row;
+}
+
+void Pregenerator::LateGenerateRow(Row & row)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	//Chuncks three apart never write in the same neighbour, each pass runs in parallel
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		int first = 1 + pass;
+		int count = ((int)row.size() - 1 - first + 2) / 3;
+		ParallelFor(count, [&row, first](int i)
+		{
+			std::vector<SubChunck*> spilled;//Nothing is meshed yet
+			row[first + 3 * i]->LateGenerateBlocks(spilled);
+		});
+	}
+
+	m_treesTime += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Pregenerator::CompleteRow(Row & row)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	//Meshed like in the game, saved only when the mesh cache is filled too
+	ParallelFor((int)row.size() - 2, [this, &row](int i)
+	{
+		for (int y = 0; y < Chunck::height; ++y)
+		{
+			std::chrono::high_resolution_clock::time_point meshStart = std::chrono::high_resolution_clock::now();
+			row[i + 1]->GenerateMesh(y);
+			float meshTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - meshStart).count();
+			SubChunck * subChunck = row[i + 1]->GetSubChunck(y);
+			if (m_meshes.Enabled() && subChunck->HasFaces())
+				m_meshes.Save(subChunck, subChunck->ContentHash(), meshTime);
+		}
+	});
+	m_meshTime += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+	ParallelFor((int)row.size() - 2, [this, &row](int i)
+	{
+		Chunck * chunck = row[i + 1];
+		glm::ivec3 pos = chunck->Position();
+
+		//Never overwrites a chunck the player may have edited
+		if (m_regions.Contains(pos.x, pos.z))
+		{
+			++m_skipped;
+			return;
+		}
+
+		std::vector<uint8_t> data;
+		chunck->Compress(data);
+		m_regions.Save(pos.x, pos.z, data);
+		m_bytes += data.size();
+		++m_saved;
+	});
+}
+
+void Pregenerator::ReleaseRow(Row & row)
+{
+	for (Chunck * chunck : row)
+	{
+		for (int face = SubChunck::right; face <= SubChunck::back; ++face)
+			if (face != SubChunck::top && face != SubChunck::bottom && chunck->Neighbour(face))
+				chunck->Neighbour(face)->SetNeighbour(face ^ 1, nullptr);
+		m_pool.Release(chunck);
+	}
+	row.clear();
+}
+
+int Pregenerator::Saved() const { return m_saved; }
+int Pregenerator::Skipped() const { return m_skipped; }
+size_t Pregenerator::Bytes() const { return m_bytes; }
+float Pregenerator::Time() const { return m_time; }
+float Pregenerator::BlocksTime() const { return m_blocksTime; }
+float Pregenerator::TreesTime() const { return m_treesTime; }
+float Pregenerator::MeshTime() const { return m_meshTime; }
@@ -30,10 +30,10 @@ TreeGen::TreeGen() :
 	 
 }
 
-Node * TreeGen::GenerateTree(glm::vec3 position, float maxLenght)
+Node * TreeGen::GenerateTree(glm::vec3 position, float maxLenght, unsigned seed)
 {
 	//Random gen
-	generator.seed( Input::FrameCount() );
+	generator.seed( seed );
 
 	//Init
 	Node * root = new Node(position, nullptr, 0);
@@ -1,23 +1,73 @@
 #include "engine/map/Chunck.h"
 
+#include <cstring>
+
 const int seed = 33;
 PerlinNoise Chunck::perlinGen(seed);
 
-TreeGen Chunck::m_treeGen;
-std::default_random_engine Chunck::generator(seed);
-std::uniform_real_distribution<float> Chunck::distribution(0.f, 1.f);
-
 
-Chunck::Chunck(int x, int z) :
-	m_positionX(x),
-	m_positionZ(z),
-	m_enabled(true)
+Chunck::Chunck(ChunckPool * pool) :
+	m_enabled(true),
+	m_positionX(0),
+	m_positionZ(0)
 { 
 	for (int y = 0; y < Chunck::height; ++y)
-		m_subChuncks[y] = new SubChunck(glm::ivec3(x, y, z), this);
+		m_subChuncks[y] = new SubChunck(this, pool);
+
+	//Vertical neighbours never change
+	for (int y = 0; y < Chunck::height; ++y)
+	{
+		m_subChuncks[y]->m_neighbours[SubChunck::top] = y + 1 < Chunck::height ? m_subChuncks[y + 1] : nullptr;
+		m_subChuncks[y]->m_neighbours[SubChunck::bottom] = y > 0 ? m_subChuncks[y - 1] : nullptr;
+	}
+}
+
+void Chunck::Reset(int x, int z)
+{
+	m_positionX = x;
+	m_positionZ = z;
+	m_enabled = true;
+	m_resident = false;
+	m_generateLater = false;
+	m_blocksGenerated = false;
+	m_lateGenerated = false;
+	m_modified = false;
+
+	for (int y = 0; y < Chunck::height; ++y)
+		m_subChuncks[y]->Reset(glm::ivec3(x, y, z));
+	std::memset(m_heights, 0, sizeof(m_heights));
+
+	SetNeighbour(SubChunck::right, nullptr);
+	SetNeighbour(SubChunck::left, nullptr);
+	SetNeighbour(SubChunck::front, nullptr);
+	SetNeighbour(SubChunck::back, nullptr);
+}
+
+Chunck * Chunck::Neighbour(int face) const
+{
+	return m_neighbours[face];
+}
+
+void Chunck::SetNeighbour(int face, Chunck * chunck)
+{
+	m_neighbours[face] = chunck;
+	for (int y = 0; y < Chunck::height; ++y)
+		m_subChuncks[y]->m_neighbours[face] = chunck ? chunck->m_subChuncks[y] : nullptr;
+}
+
+void Chunck::Unload()
+{
+	for (int y = 0; y < Chunck::height; ++y)
+		m_subChuncks[y]->Unload();
+
+	for (Node * tree : m_pendingTrees)
+		delete tree;
+	m_pendingTrees.clear();
+
+	m_blocksGenerated = false;
 }
 
-Block* Chunck::GetBlock(glm::ivec3 position)
+const Block* Chunck::GetBlock(glm::ivec3 position) const
 {
 	if(position.y < 0 || position.y >= Chunck::height * SubChunck::size)
 		return nullptr;
@@ -29,6 +79,81 @@ Block* Chunck::GetBlock(glm::ivec3 position)
 		return nullptr;
 }
 
+void Chunck::SetBlock(glm::ivec3 position, Block::Type type)
+{
+	if (position.y >= 0 && position.y < Chunck::height * SubChunck::size)
+	{
+		m_subChuncks[position.y / SubChunck::size]->SetBlock(glm::ivec3(position.x, position.y % SubChunck::size, position.z), type);
+		UpdateHeights(position, type);
+		m_modified = true;
+	}
+}
+
+static_assert(SubChunck::size * Chunck::height <= 255, "heights are stored on a byte");
+
+int Chunck::Height(int x, int z, Heightmap heightmap) const
+{
+	return m_heights[heightmap][x * SubChunck::size + z];
+}
+
+bool Chunck::InHeightmap(const Block & block, int heightmap)
+{
+	switch (heightmap)
+	{
+	case surface: return block.type != Block::Type::air;
+	case solid: return block.solid;
+	default: return block.solid && !block.seeThrough;
+	}
+}
+
+void Chunck::UpdateHeights(glm::ivec3 position, Block::Type type)
+{
+	Block block;
+	block.SetType(type);
+
+	for (int heightmap = 0; heightmap < heightmapsCount; ++heightmap)
+	{
+		uint8_t & height = m_heights[heightmap][position.x * SubChunck::size + position.z];
+		if (InHeightmap(block, heightmap))
+			height = (uint8_t)std::max((int)height, position.y + 1);
+		else if (position.y + 1 == height)
+		{
+			//The highest block is removed, walks down the column to the next one
+			int y = position.y - 1;
+			while (y >= 0 && !InHeightmap(*GetBlock(glm::ivec3(position.x, y, position.z)), heightmap))
+				--y;
+			height = (uint8_t)(y + 1);
+		}
+	}
+}
+
+void Chunck::BuildHeightmaps()
+{
+	static_assert(sizeof(m_heights[0]) == SubChunck::size * SubChunck::size, "one height per column");
+
+	//One walk down each column finds the top of every heightmap
+	for (int x = 0; x < SubChunck::size; ++x)
+		for (int z = 0; z < SubChunck::size; ++z)
+		{
+			bool found[heightmapsCount] = {};
+			int remaining = heightmapsCount;
+			for (int y = SubChunck::size * Chunck::height - 1; y >= 0 && remaining > 0; --y)
+			{
+				const Block * block = GetBlock(glm::ivec3(x, y, z));
+				for (int heightmap = 0; heightmap < heightmapsCount; ++heightmap)
+					if (!found[heightmap] && InHeightmap(*block, heightmap))
+					{
+						m_heights[heightmap][x * SubChunck::size + z] = (uint8_t)(y + 1);
+						found[heightmap] = true;
+						--remaining;
+					}
+			}
+			for (int heightmap = 0; heightmap < heightmapsCount; ++heightmap)
+				if (!found[heightmap])
+					m_heights[heightmap][x * SubChunck::size + z] = 0;
+		}
+}
+
 SubChunck*  Chunck::GetSubChunck(int  height)
 {
 	if (height < 0 || height >= Chunck::height)
@@ -45,6 +170,12 @@ void Chunck::Update(float delta)
 
 void Chunck::GenerateBlocks()	
 {
+	//Trees are seeded by the chunck position, several threads generate the same world in any order
+	std::seed_seq treeSeed = { seed, m_positionX, m_positionZ };
+	std::default_random_engine generator(treeSeed);
+	std::uniform_real_distribution<float> distribution(0.f, 1.f);
+	TreeGen treeGen;
+
 	//Set stone
 	for (int x = 0; x < SubChunck::size; ++x)
 		for (int y = 0; y < SubChunck::size * Chunck::height; ++y)
@@ -75,37 +206,37 @@ void Chunck::GenerateBlocks()
 				float density = 0.3f * density3D + 0.7f* density2D* density2D;
 
 				if (density > 0.7f)
-					GetBlock( glm::ivec3(x,y,z) )->SetType(Block::Type::stone);
+					SetBlock( glm::ivec3(x,y,z), Block::Type::stone);
 				else
-					GetBlock(glm::ivec3(x, y, z))->SetType(Block::Type::air);
+					SetBlock(glm::ivec3(x, y, z), Block::Type::air);
 
 			}
 	
-	//Set dirt
+	//Set dirt, nothing to cover above the surface
 	for (int x = 0; x < SubChunck::size; ++x)
-		for (int y = 0; y < SubChunck::size * Chunck::height; ++y)
-			for (int z = 0; z < SubChunck::size; ++z)
+		for (int z = 0; z < SubChunck::size; ++z)
+			for (int y = 0; y < Height(x, z, surface); ++y)
 			{
 				glm::ivec3 pos = glm::ivec3(SubChunck::size * m_positionX + x, y, SubChunck::size * m_positionZ +  z);
 
 				int nbDirt = (int)(10.f * ( 1.f - (float)pos.y / (SubChunck::size * Chunck::height)));
 
-				Block* otherBlock = GetBlock(glm::ivec3(x, y+1, z));
-				Block* block = GetBlock( glm::ivec3(x, y, z));
+				const Block* otherBlock = GetBlock(glm::ivec3(x, y+1, z));
+				const Block* block = GetBlock( glm::ivec3(x, y, z));
 
 				if (block->type == Block::Type::stone && (!otherBlock || !otherBlock->solid))
 					for (int i = 0; i < (int)nbDirt; ++i)
 					{
-						Block* blockDirt = GetBlock(glm::ivec3(x, y - i, z));
+						const Block* blockDirt = GetBlock(glm::ivec3(x, y - i, z));
 						if (blockDirt && blockDirt->type == Block::Type::stone)
-							blockDirt->SetType(Block::Type::dirt);
+							SetBlock(glm::ivec3(x, y - i, z), Block::Type::dirt);
 					}
 			}
 
-	//Set caves
+	//Set caves, the sky is already empty
 	for (int x = 0; x < SubChunck::size; ++x)
-		for (int y = 0; y < SubChunck::size * Chunck::height; ++y)
-			for (int z = 0; z < SubChunck::size; ++z)
+		for (int z = 0; z < SubChunck::size; ++z)
+			for (int y = 0, top = Height(x, z, surface); y < top; ++y)
 			{
 				glm::ivec3 pos = glm::ivec3(SubChunck::size * m_positionX + x, y, SubChunck::size * m_positionZ + z);
 
@@ -121,20 +252,20 @@ void Chunck::GenerateBlocks()
 
 				//Set blocks
 				if (cavesDensity < 0.4 * ( 1.f - 2 * pow(hratio,3))   )
-					GetBlock(glm::ivec3(x, y, z))->SetType(Block::Type::air);
+					SetBlock(glm::ivec3(x, y, z), Block::Type::air);
 			}
 
 	//Set grass	
 	for (int x = 0; x < SubChunck::size; ++x)
-		for (int y = 0; y < SubChunck::size * Chunck::height; ++y)
-			for (int z = 0; z < SubChunck::size; ++z)
+		for (int z = 0; z < SubChunck::size; ++z)
+			for (int y = 0; y < Height(x, z, surface); ++y)
 			{
 				glm::ivec3 pos = glm::ivec3(SubChunck::size * m_positionX + x, y, SubChunck::size * m_positionZ + z);
 
-				Block* otherBlock = GetBlock(glm::ivec3(x, y + 1, z));
+				const Block* otherBlock = GetBlock(glm::ivec3(x, y + 1, z));
 				if (GetBlock(glm::ivec3(x, y, z))->type == Block::Type::dirt && (!otherBlock || !otherBlock->solid))
 				{
-					GetBlock(glm::ivec3(x, y, z))->SetType(Block::Type::grass);
+					SetBlock(glm::ivec3(x, y, z), Block::Type::grass);
 					
 					float heightRatio = (float)y / SubChunck::size * Chunck::height;
 
@@ -142,7 +273,7 @@ void Chunck::GenerateBlocks()
 
 					if (heightRatio * distribution(generator) < 0.3f)
 					{
-						Node * treeRoot = m_treeGen.GenerateTree(pos, 6 + distribution(generator) * 6);
+						Node * treeRoot = treeGen.GenerateTree(pos, 6 + distribution(generator) * 6, generator());
 						m_pendingTrees.push_back(treeRoot);
 					}
 				}
@@ -152,17 +283,51 @@ void Chunck::GenerateBlocks()
 		for (int y = 0; y < 5; ++y)
 			for (int z = 0; z < SubChunck::size; ++z)
 			{
-				glm::ivec3 pos = glm::ivec3(SubChunck::size * m_positionX + x, y, SubChunck::size * m_positionZ + z);
-				GetBlock(glm::ivec3(x, y, z))->SetType(Block::Type::bedrock);
+				SetBlock(glm::ivec3(x, y, z), Block::Type::bedrock);
 			}
 
+	//Sky and deep underground subChuncks give their blocks back to the pool
+	for (int y = 0; y < Chunck::height; ++y)
+		m_subChuncks[y]->Compact();
+
+	//Generated again identically, nothing to save yet
 	m_blocksGenerated = true;
+	m_modified = false;
+}
+
+void Chunck::LateGenerateBlocks(std::vector<SubChunck*> & spilled)
+{
+	//Its own trees are generated again with the chunck, the leaves spilled by the neighbours trees are not and keep it modified
+	bool modified = m_modified;
+	for (Node * tree : m_pendingTrees)
+	{
+		GenerateTree(tree, spilled);
+		delete tree;
+	}
+	m_pendingTrees.clear();
+	m_lateGenerated = true;
+	m_modified = modified;
+}
+
+void Chunck::Compress(std::vector<uint8_t> & data) const
+{
+	for (int y = 0; y < Chunck::height; ++y)
+		m_subChuncks[y]->Compress(data);
 }
 
-void Chunck::LateGenerateBlocks()
+bool Chunck::Decompress(const uint8_t * data, size_t size)
 {
-	for( Node * tree : m_pendingTrees)
-    		GenerateTree(tree);
+	const uint8_t * end = data + size;
+	for (int y = 0; y < Chunck::height && data; ++y)
+		data = m_subChuncks[y]->Decompress(data, end);
+	if (!data)
+		return false;
+
+	BuildHeightmaps();
+	m_blocksGenerated = true;
+	m_lateGenerated = true;
+	m_modified = false;
+	return true;
 }
 
 void Chunck::GenerateMesh( int subChunck )
@@ -188,18 +353,25 @@ void Chunck::GenerateCollider( int subChunck, bool regenerate)
 			 m_subChuncks[subChunck]->GenerateCollider();
 }
 
-void Chunck::DrawTransparent(const Shader & shader) const
+void Chunck::DrawTransparent(std::vector<MeshArena::DrawCall> & draws) const
 {
 	if (m_enabled)
 		for (int y = 0; y <Chunck::height; ++y)
-			m_subChuncks[y]->DrawTransparent(shader);
+			m_subChuncks[y]->DrawTransparent(draws);
 }
 
-void Chunck::DrawOpaque(const Shader & shader) const
+void Chunck::DrawOpaque(std::vector<MeshArena::DrawCall> & draws) const
 {
 	if (m_enabled)
 		for (int y = 0; y <Chunck::height; ++y)
-			m_subChuncks[y]->DrawOpaque(shader);
+			m_subChuncks[y]->DrawOpaque(draws);
+}
+
+void Chunck::DrawCasters(std::vector<MeshArena::DrawCall> & draws, uint32_t subChuncks) const
+{
+	for (int y = 0; y < Chunck::height; ++y)
+		if (subChuncks & (1u << y))
+			m_subChuncks[y]->DrawCaster(draws);
 }
 
 void Chunck::SetEnabled(bool state)
@@ -214,14 +386,53 @@ void Chunck::SetSubChunckEnabled(int subChunck, bool state)
 	m_subChuncks[subChunck]->SetEnabled(state);
 }
 
+void Chunck::SetResident(bool state)
+{
+	if (m_resident == state)
+		return;
+
+	//Staged or evicted chuncks leave the shadow casters too, their cascades are drawn again
+	m_resident = state;
+	for (int y = 0; y < Chunck::height; ++y)
+	{
+		if (m_subChuncks[y]->m_meshOpaque.count > 0)
+			World::MeshChanged(m_subChuncks[y]->m_position);
+		m_subChuncks[y]->UpdateCullRecord();
+	}
+}
+
 bool Chunck::Enabled() const { return m_enabled; }
+bool Chunck::Resident() const { return m_resident; }
 bool Chunck::BlocksGenerated() const { return m_blocksGenerated; }
+bool Chunck::LateGenerated() const { return m_lateGenerated; }
+bool Chunck::Modified() const { return m_modified; }
+void Chunck::SetModified(bool state) { m_modified = state; }
 
 
 glm::ivec3 Chunck::Position() const{return glm::ivec3(m_positionX,0, m_positionZ);}
 
-void Chunck::GenerateTree(Node * tree)
+Chunck * Chunck::Locate(glm::ivec3 & position)
+{
+	//Trees never reach further than the chuncks around
+	int dx = FloorDiv(position.x, SubChunck::size) - m_positionX;
+	int dz = FloorDiv(position.z, SubChunck::size) - m_positionZ;
+	if (dx < -1 || dx > 1 || dz < -1 || dz > 1)
+		return nullptr;
+
+	Chunck * chunck = this;
+	if (dx != 0)
+		chunck = chunck->m_neighbours[dx > 0 ? SubChunck::right : SubChunck::left];
+	if (chunck && dz != 0)
+		chunck = chunck->m_neighbours[dz > 0 ? SubChunck::front : SubChunck::back];
+
+	if (chunck)
+		position = glm::ivec3(FloorMod(position.x, SubChunck::size), position.y, FloorMod(position.z, SubChunck::size));
+	return chunck;
+}
+
+void Chunck::GenerateTree(Node * tree, std::vector<SubChunck*> & spilled)
 {
+	//Goes through the neighbours pointers instead of the world, works on chuncks outside of it
 	std::stack<Node * > stack;
 	stack.push(tree);
 	while (!stack.empty())
@@ -229,18 +440,24 @@ void Chunck::GenerateTree(Node * tree)
 		Node * node = stack.top();
 		stack.pop();
 
-		Block* block = World::GetBlock(node->position);
+		glm::ivec3 position = glm::ivec3(node->position);
+		Chunck * chunck = Locate(position);
+		const Block* block = chunck ? chunck->GetBlock(position) : nullptr;
 		if (block)
 		{
+			Block::Type type = Block::Type::air;
 			if (node->depth <= 2 && (block->type == Block::air || block->type == Block::leaf))
-			{
-				World::SetBlock(node->position, Block::Type::wood);
-				World::UpdateBlock(node->position);
-			}
+				type = Block::Type::wood;
 			else if (block->type == Block::air)
+				type = Block::Type::leaf;
+
+			if (type != Block::Type::air)
 			{
-				World::SetBlock(node->position, Block::Type::leaf);
-				World::UpdateBlock(node->position);
+				chunck->SetBlock(position, type);
+
+				SubChunck * subChunck = chunck->m_subChuncks[position.y / SubChunck::size];
+				if (chunck != this && std::find(spilled.begin(), spilled.end(), subChunck) == spilled.end())
+					spilled.push_back(subChunck);
 			}
 		}
 		for (Node * n : node->next)
@@ -250,6 +467,8 @@ void Chunck::GenerateTree(Node * tree)
 
 Chunck::~Chunck()
 {
+	for (Node * tree : m_pendingTrees)
+		delete tree;
 	for (int y = 0; y <Chunck::height; ++y)
 		delete m_subChuncks[y];
 }
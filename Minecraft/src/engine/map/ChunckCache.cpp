@@ -0,0 +1,63 @@
+#include "engine/map/ChunckCache.h"
+#include "engine/map/Chunck.h"
+
+ChunckCache::ChunckCache(size_t capacity) :
+	m_capacity(capacity),
+	m_size(0)
+{
+}
+
+void ChunckCache::Store(int x, int z, const std::vector<uint8_t> & data)
+{
+	uint64_t key = ChunckMap::Key(x, z);
+
+	std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+	if (it != m_index.end())
+		Erase(it->second);
+
+	m_entries.push_front({ key, data });
+	m_index[key] = m_entries.begin();
+	m_size += m_entries.front().data.size();
+
+	Trim();
+}
+
+bool ChunckCache::Restore(Chunck * chunck)
+{
+	glm::ivec3 pos = chunck->Position();
+	std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator it = m_index.find(ChunckMap::Key(pos.x, pos.z));
+	if (it == m_index.end())
+		return false;
+
+	bool restored = chunck->Decompress(it->second->data.data(), it->second->data.size());
+	Erase(it->second);
+	return restored;
+}
+
+bool ChunckCache::Contains(int x, int z) const
+{
+	return m_index.find(ChunckMap::Key(x, z)) != m_index.end();
+}
+
+void ChunckCache::Erase(std::list<Entry>::iterator entry)
+{
+	m_size -= entry->data.size();
+	m_index.erase(entry->key);
+	m_entries.erase(entry);
+}
+
+void ChunckCache::Trim()
+{
+	while (m_size > m_capacity && !m_entries.empty())
+		Erase(std::prev(m_entries.end()));
+}
+
+void ChunckCache::SetCapacity(size_t capacity)
+{
+	m_capacity = capacity;
+	Trim();
+}
+
+size_t ChunckCache::Capacity() const { return m_capacity; }
+size_t ChunckCache::Size() const { return m_size; }
+int ChunckCache::Count() const { return (int)m_entries.size(); }
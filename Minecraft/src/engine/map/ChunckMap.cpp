@@ -0,0 +1,123 @@
+#include "engine/map/ChunckMap.h"
+
+ChunckMap::ChunckMap(int capacity) :
+	m_mask(0),
+	m_count(0),
+	m_version(0)
+{
+	int powerOfTwo = 16;
+	while (powerOfTwo < capacity)
+		powerOfTwo *= 2;
+	Rehash(powerOfTwo);
+}
+
+uint64_t ChunckMap::Key(int x, int z)
+{
+	return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+}
+
+int ChunckMap::KeyX(uint64_t key)
+{
+	return (int)(int32_t)(key >> 32);
+}
+
+int ChunckMap::KeyZ(uint64_t key)
+{
+	return (int)(int32_t)(key & 0xffffffff);
+}
+
+uint64_t ChunckMap::Hash(uint64_t key)
+{
+	//Murmur3 finalizer, neighbouring coordinates end up far apart
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+Chunck * ChunckMap::Get(int x, int z) const
+{
+	uint64_t key = Key(x, z);
+	for (uint64_t slot = Hash(key) & m_mask; m_slots[slot].chunck; slot = (slot + 1) & m_mask)
+		if (m_slots[slot].key == key)
+			return m_slots[slot].chunck;
+	return nullptr;
+}
+
+void ChunckMap::Set(int x, int z, Chunck * chunck)
+{
+	++m_version;
+
+	uint64_t key = Key(x, z);
+	uint64_t slot = Hash(key) & m_mask;
+	for (; m_slots[slot].chunck; slot = (slot + 1) & m_mask)
+		if (m_slots[slot].key == key)
+		{
+			if (chunck)
+				m_slots[slot].chunck = chunck;
+			else
+				Erase((int)slot);
+			return;
+		}
+
+	if (!chunck)
+		return;
+
+	m_slots[slot].key = key;
+	m_slots[slot].chunck = chunck;
+	++m_count;
+
+	if (2 * m_count > (int)m_slots.size())
+		Rehash(2 * (int)m_slots.size());
+}
+
+void ChunckMap::Erase(int slot)
+{
+	//Backward shift deletion, no tombstones
+	uint64_t hole = slot;
+	for (uint64_t next = (hole + 1) & m_mask; m_slots[next].chunck; next = (next + 1) & m_mask)
+	{
+		uint64_t ideal = Hash(m_slots[next].key) & m_mask;
+		//Moves the entry if the hole is between its ideal slot and its current slot
+		if (((next - ideal) & m_mask) >= ((next - hole) & m_mask))
+		{
+			m_slots[hole] = m_slots[next];
+			hole = next;
+		}
+	}
+	m_slots[hole].chunck = nullptr;
+	--m_count;
+}
+
+void ChunckMap::Rehash(int capacity)
+{
+	std::vector<Slot> slots = std::move(m_slots);
+	m_slots.assign(capacity, { 0, nullptr });
+	m_mask = capacity - 1;
+	m_count = 0;
+
+	for (const Slot & slot : slots)
+		if (slot.chunck)
+		{
+			uint64_t index = Hash(slot.key) & m_mask;
+			while (m_slots[index].chunck)
+				index = (index + 1) & m_mask;
+			m_slots[index] = slot;
+			++m_count;
+		}
+}
+
+void ChunckMap::Clear()
+{
+	for (Slot & slot : m_slots)
+		slot.chunck = nullptr;
+	m_count = 0;
+	++m_version;
+}
+
+int ChunckMap::Count() const { return m_count; }
+uint32_t ChunckMap::Version() const { return m_version; }
+int ChunckMap::Capacity() const { return (int)m_slots.size(); }
+Chunck * ChunckMap::At(int slot) const { return m_slots[slot].chunck; }
@@ -0,0 +1,93 @@
+#include "engine/map/ChunckPool.h"
+
+ChunckPool::ChunckPool(int capacity)
+{
+	while ((int)m_chuncks.size() < capacity)
+		Grow(growSize);
+}
+
+void ChunckPool::Grow(int count)
+{
+	//Reserve the free list for every chunck so that Release never allocates
+	m_chuncks.reserve(m_chuncks.size() + count);
+	m_free.reserve(m_chuncks.size() + count);
+	for (int i = 0; i < count; ++i)
+	{
+		Chunck * chunck = new Chunck(this);
+		m_chuncks.push_back(chunck);
+		m_free.push_back(chunck);
+	}
+}
+
+void ChunckPool::GrowBlocks()
+{
+	Block * slab = new Block[slabSize * SubChunck::volume];
+	m_slabs.push_back(slab);
+
+	m_freeBlocks.reserve(m_slabs.size() * slabSize);
+	for (int i = 0; i < slabSize; ++i)
+		m_freeBlocks.push_back(slab + i * SubChunck::volume);
+}
+
+Chunck * ChunckPool::Acquire(int x, int z)
+{
+	m_mutex.lock();
+	if (m_free.empty())
+		Grow(growSize);
+	Chunck * chunck = m_free.back();
+	m_free.pop_back();
+	m_mutex.unlock();
+
+	chunck->Reset(x, z);
+	return chunck;
+}
+
+void ChunckPool::Release(Chunck * chunck)
+{
+	if (!chunck)
+		return;
+
+	//Frees graphics and physics resources, must be called from the main thread
+	chunck->Unload();
+
+	m_mutex.lock();
+	m_free.push_back(chunck);
+	m_mutex.unlock();
+}
+
+Block * ChunckPool::AcquireBlocks()
+{
+	m_mutex.lock();
+	if (m_freeBlocks.empty())
+		GrowBlocks();
+	Block * blocks = m_freeBlocks.back();
+	m_freeBlocks.pop_back();
+	m_mutex.unlock();
+	return blocks;
+}
+
+void ChunckPool::ReleaseBlocks(Block * blocks)
+{
+	m_mutex.lock();
+	m_freeBlocks.push_back(blocks);
+	m_mutex.unlock();
+}
+
+MeshArena & ChunckPool::Arena() { return m_arena; }
+GpuCuller & ChunckPool::Culler() { return m_culler; }
+
+int ChunckPool::Capacity() const { return (int)m_chuncks.size(); }
+int ChunckPool::Available() const { return (int)m_free.size(); }
+int ChunckPool::BlocksInUse() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)(m_slabs.size() * slabSize - m_freeBlocks.size());
+}
+
+ChunckPool::~ChunckPool()
+{
+	for (Chunck * chunck : m_chuncks)
+		delete chunck;
+	for (Block * slab : m_slabs)
+		delete[] slab;
+}
@@ -0,0 +1,667 @@
+#include <engine/map/ChunckStreamer.h>
+
+#include <chrono>
+
+
+
+ChunckStreamer::ChunckStreamer(int expectedSize) :
+	m_chunckPool( new ChunckPool((int)BuildSpiral(expectedSize).size() + 2 * (1 + maxPrefetchDepth) * expectedSize)),
+	m_chunckGenerator( new ChunckGenerator(m_chunckPool, "world/meshes")),
+	m_regions("world"),
+	m_journal("world/edits.journal")
+{
+	//The generator decodes the saved chuncks on its thread instead of generating them
+	m_chunckGenerator->SetLoader([this](Chunck * chunck)
+	{
+		glm::ivec3 pos = chunck->Position();
+		if (!m_regions.Contains(pos.x, pos.z))
+			return false;
+		if (m_regions.Load(chunck))
+			return true;
+
+		std::cerr << "ERROR: ChunckStreamer::ChunckStreamer corrupted chunck " << pos.x << " " << pos.z << std::endl;
+		return false;
+	});
+}
+
+std::vector<glm::ivec2> ChunckStreamer::BuildSpiral(int size)
+{
+	const float center = (size - 1) / 2.f;
+	const float radius = size / 2.f;
+
+	std::vector<glm::ivec2> spiral;
+	for (int x = 0; x < size; ++x)
+		for (int z = 0; z < size; ++z)
+		{
+			glm::vec2 delta = glm::vec2(x - center, z - center);
+			if (glm::dot(delta, delta) <= radius * radius)
+				spiral.push_back(glm::ivec2(x, z));
+		}
+
+	//Sort by distance to the center then by angle so that rings are walked in order
+	std::sort(spiral.begin(), spiral.end(), [center](const glm::ivec2 & a, const glm::ivec2 & b)
+	{
+		glm::vec2 da = glm::vec2(a.x - center, a.y - center);
+		glm::vec2 db = glm::vec2(b.x - center, b.y - center);
+		float distA = glm::dot(da, da);
+		float distB = glm::dot(db, db);
+		if (distA != distB)
+			return distA < distB;
+		return std::atan2(da.y, da.x) < std::atan2(db.y, db.x);
+	});
+	return spiral;
+}
+
+bool ChunckStreamer::InsideAnchor(const Anchor & anchor, int x, int z)
+{
+	if (!anchor.used || x < anchor.originX || x >= anchor.originX + anchor.size || z < anchor.originZ || z >= anchor.originZ + anchor.size)
+		return false;
+	float dx = x - anchor.originX - (anchor.size - 1) / 2.f;
+	float dz = z - anchor.originZ - (anchor.size - 1) / 2.f;
+	return dx * dx + dz * dz <= (anchor.size / 2.f) * (anchor.size / 2.f);
+}
+
+bool ChunckStreamer::Resident(int x, int z) const
+{
+	for (const Anchor & anchor : m_anchors)
+		if (InsideAnchor(anchor, x, z))
+			return true;
+	return false;
+}
+
+float ChunckStreamer::DistanceToCenter(int x, int z) const
+{
+	//Distance to the closest anchor
+	float distance = std::numeric_limits<float>::max();
+	for (const Anchor & anchor : m_anchors)
+		if (anchor.used)
+		{
+			float dx = x - anchor.originX - (anchor.size - 1) / 2.f;
+			float dz = z - anchor.originZ - (anchor.size - 1) / 2.f;
+			distance = std::min(distance, std::sqrt(dx * dx + dz * dz));
+		}
+	return distance;
+}
+
+int ChunckStreamer::DistanceOutside(int x, int z) const
+{
+	int distance = std::numeric_limits<int>::max();
+	for (const Anchor & anchor : m_anchors)
+		if (anchor.used)
+		{
+			float dx = x - anchor.originX - (anchor.size - 1) / 2.f;
+			float dz = z - anchor.originZ - (anchor.size - 1) / 2.f;
+			distance = std::min(distance, (int)std::ceil(std::sqrt(dx * dx + dz * dz) - anchor.size / 2.f));
+		}
+	return distance;
+}
+
+void ChunckStreamer::UpdateSubChunckMesh(SubChunck* subChunck)
+{
+	if (subChunck)
+		m_genMeshLater.emplace(subChunck);
+}
+
+void ChunckStreamer::RecordEdit(glm::ivec3 position, Block::Type oldType, Block::Type newType, uint32_t tick)
+{
+	if (m_scratchJournal)
+	{
+		m_scratchJournal->Append({ position, (uint8_t)oldType, (uint8_t)newType, tick });
+		return;
+	}
+
+	m_journal.Append({ position, (uint8_t)oldType, (uint8_t)newType, tick });
+	if (m_journal.Size() >= EditJournal::compactSize && !m_journal.Compacting())
+		CompactJournal();
+}
+
+void ChunckStreamer::SetScratchJournal(EditJournal * journal)
+{
+	m_scratchJournal = journal;
+}
+
+void ChunckStreamer::CompactJournal()
+{
+	//Snapshots the edited chuncks still in memory, the evicted ones were saved when they left
+	for (const glm::ivec2 & pos : m_journal.EditedChuncks())
+	{
+		Chunck * chunck = Get(pos.x, pos.y);
+		if (!chunck)
+		{
+			std::map<std::pair<int, int>, Chunck*>::iterator it = m_staging.find(std::make_pair(pos.x, pos.y));
+			if (it != m_staging.end())
+				chunck = it->second;
+		}
+
+		if (chunck && chunck->LateGenerated() && chunck->Modified())
+		{
+			std::vector<uint8_t> data;
+			chunck->Compress(data);
+			m_regions.Save(pos.x, pos.y, data);
+		}
+	}
+
+	m_journal.Compact([this]() { m_regions.Flush(); });
+}
+
+void ChunckStreamer::ReplayEdits(Chunck * chunck)
+{
+	glm::ivec3 pos = chunck->Position();
+	for (const EditJournal::Edit & edit : m_journal.TakeReplay(pos.x, pos.z))
+		chunck->SetBlock(glm::ivec3(FloorMod(edit.position.x, SubChunck::size), edit.position.y, FloorMod(edit.position.z, SubChunck::size)), (Block::Type)edit.newType);
+}
+
+bool ChunckStreamer::LoadCachedMesh(SubChunck * subChunck)
+{
+	MeshCache & meshes = Meshes();
+	if (subChunck->generating || !meshes.Enabled() || !subChunck->HasFaces())
+		return false;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	float savedMeshTime = 0.f;
+	if (!meshes.Load(subChunck, subChunck->ContentHash(), savedMeshTime))
+		return false;
+	subChunck->ComputeConnectivity();
+	float time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+	meshes.AddTimeSaved(std::max(savedMeshTime - time, 0.f));
+
+	//Staged like a mesh popped from the generator, generating keeps it from being remeshed or released before its model is made
+	subChunck->generating = true;
+	m_waitingModels.push_back(subChunck);
+	return true;
+}
+
+void ChunckStreamer::ScheduleUpdate(SubChunck * subChunck)
+{
+	m_active.insert(subChunck);
+}
+
+void ChunckStreamer::UpdateActive(float delta)
+{
+	//Updates may schedule other subChuncks
+	std::vector<SubChunck*> active(m_active.begin(), m_active.end());
+	m_active.clear();
+
+	for (SubChunck * subChunck : active)
+	{
+		subChunck->Update(delta);
+		if (subChunck->PendingUpdate())
+			m_active.insert(subChunck);
+	}
+}
+
+void ChunckStreamer::ForgetPendingWork(Chunck * chunck)
+{
+	m_waitingFirstGen.erase(std::remove(m_waitingFirstGen.begin(), m_waitingFirstGen.end(), chunck), m_waitingFirstGen.end());
+	m_waitingLateGen.erase(std::remove(m_waitingLateGen.begin(), m_waitingLateGen.end(), chunck), m_waitingLateGen.end());
+	for (int y = 0; y < Chunck::height; ++y)
+	{
+		m_genMeshLater.erase(chunck->GetSubChunck(y));
+		m_active.erase(chunck->GetSubChunck(y));
+	}
+}
+
+void ChunckStreamer::DeleteChunck(Chunck * chunck)
+{
+	if (chunck)
+	{
+		//Complete chuncks are kept compressed and saved, edits included
+		if (chunck->LateGenerated())
+		{
+			glm::ivec3 pos = chunck->Position();
+			std::vector<uint8_t> data;
+			chunck->Compress(data);
+			if (chunck->Modified())
+				m_regions.Save(pos.x, pos.z, data);
+			m_cache.Store(pos.x, pos.z, data);
+		}
+
+		//The chunck will be recycled, forget every pending work referencing it
+		ForgetPendingWork(chunck);
+		m_toDelete.push_back(std::make_pair(chunck, m_chunckGenerator->MeshRounds()));
+	}
+}
+
+void ChunckStreamer::StageChunck(Chunck * chunck)
+{
+	ForgetPendingWork(chunck);
+	glm::ivec3 pos = chunck->Position();
+	m_staging[std::make_pair(pos.x, pos.z)] = chunck;
+}
+
+void ChunckStreamer::Update(float delta)
+{
+	//Delete chuncks, once neither they nor a neighbour meshed through their pointers are being meshed
+	const uint64_t meshRounds = m_chunckGenerator->MeshRounds();
+	for (int i = 0; i < (int)m_toDelete.size(); ++i)
+	{
+		Chunck * chunck = m_toDelete[i].first;
+		if (!chunck)
+		{
+			m_toDelete[i] = m_toDelete[m_toDelete.size() - 1];
+			m_toDelete.pop_back();
+			--i;
+		}
+		else
+		{
+			bool generating = meshRounds == m_toDelete[i].second;
+			for( int y = 0; y < Chunck::height && !generating; ++y)
+				if (chunck->GetSubChunck(y)->generating)
+					generating = true;
+			if (!generating)
+			{
+				m_chunckPool->Release(chunck);
+				m_toDelete[i] = m_toDelete[m_toDelete.size() - 1];
+				m_toDelete.pop_back();
+				--i;
+			}
+		}
+	}
+	
+	//Add newly allocated chuncks to world
+	std::vector<Chunck*> chuncks = m_chunckGenerator->PopChuncksGenerateds();
+	for (Chunck * chunck : chuncks)
+	{
+		glm::ivec3 pos = chunck->Position();
+		m_requested.erase(std::make_pair(pos.x, pos.z));
+
+		//Loaded from disk, complete but without the edits journaled since its save
+		if (chunck->LateGenerated())
+			ReplayEdits(chunck);
+
+		if (Resident(pos.x, pos.z) && !Get(pos.x, pos.z))
+		{
+			m_waitingFirstGen.push_back(chunck);
+			Set(pos.x, pos.z, chunck);
+		}
+		else if (!Resident(pos.x, pos.z) && DistanceOutside(pos.x, pos.z) <= maxPrefetchDepth + 1 && m_staging.find(std::make_pair(pos.x, pos.z)) == m_staging.end())
+			m_staging[std::make_pair(pos.x, pos.z)] = chunck;
+		else
+			DeleteChunck(chunck);
+	}
+	
+
+	//Generates mesh of newly allocateds chuncks
+	for (int i = 0; i < (int)m_waitingFirstGen.size(); ++i)
+	{
+		Chunck * chunck = m_waitingFirstGen[i];
+
+		glm::ivec2 pos = glm::ivec2(chunck->Position().x, chunck->Position().z);
+
+		if (Get(pos.x + 1, pos.y) && Get(pos.x + 1, pos.y)->BlocksGenerated() &&
+			Get(pos.x - 1, pos.y) && Get(pos.x - 1, pos.y)->BlocksGenerated() &&
+			Get(pos.x, pos.y + 1) && Get(pos.x, pos.y + 1)->BlocksGenerated() &&
+			Get(pos.x, pos.y - 1) && Get(pos.x, pos.y - 1)->BlocksGenerated()
+			)
+		{
+			m_waitingLateGen.push_back(chunck);
+
+			m_waitingFirstGen[i] = m_waitingFirstGen[m_waitingFirstGen.size() - 1];
+			m_waitingFirstGen.pop_back();
+			--i;
+		}
+	}
+
+	//Only one chunck per update, trees are expensive
+	if (!m_waitingLateGen.empty())
+	{
+		Chunck* chunck = m_waitingLateGen.back();
+		m_waitingLateGen.pop_back();
+		//Restored and loaded chuncks already have their trees, their blocks may match a saved mesh
+		bool restored = chunck->LateGenerated();
+		//Generates additionnal content (trees)
+		std::vector<SubChunck*> spilled;
+		chunck->LateGenerateBlocks(spilled);
+		ReplayEdits(chunck);
+		for (SubChunck * subChunck : spilled)
+		{
+			UpdateSubChunckMesh(subChunck);
+			subChunck->GenerateCollider();
+		}
+
+		//Send subChunck to generator for mesh creation
+		glm::ivec2 pos = glm::ivec2(chunck->Position().x, chunck->Position().z);
+
+		float dist = DistanceToCenter(pos.x, pos.y);
+		for (int i = 0; i < Chunck::height; ++i)
+			if (!restored || !LoadCachedMesh(chunck->GetSubChunck(i)))
+				m_chunckGenerator->GenerateMesh(chunck->GetSubChunck(i), dist);
+	}
+
+
+
+	//Send subChuncks to generator for mesh creation, the ones still meshing are sent again once their model is made
+	for (std::unordered_set<SubChunck*>::iterator it = m_genMeshLater.begin(); it != m_genMeshLater.end();)
+	{
+		SubChunck * subChunck = *it;
+		if (!subChunck->generating)
+		{
+			float dist = DistanceToCenter(subChunck->Position().x, subChunck->Position().z);
+			m_chunckGenerator->GenerateMesh(subChunck, dist);
+			it = m_genMeshLater.erase(it);
+		}
+		else
+			++it;
+	}
+
+
+
+	//Generates models, a burst of new chuncks is uploaded over several frames
+	for (SubChunck * subChunck : m_chunckGenerator->PopMeshGenerateds())
+		m_waitingModels.push_back(subChunck);
+	size_t uploaded = 0;
+	while (!m_waitingModels.empty() && uploaded < uploadBudget)
+	{
+		SubChunck * subChunck = m_waitingModels.front();
+		m_waitingModels.pop_front();
+		uploaded += subChunck->MeshBytes();
+		subChunck->GenerateModels();
+		subChunck->generating = false;
+	}
+	m_chunckPool->Arena().EndFrame();
+}
+
+int ChunckStreamer::AddAnchor(glm::ivec2 center, int size)
+{
+	Anchor state = { true, center.x - size / 2, center.y - size / 2, size, BuildSpiral(size) };
+
+	//Reuses the slot of a removed anchor
+	int anchor = 0;
+	while (anchor < (int)m_anchors.size() && m_anchors[anchor].used)
+		++anchor;
+	if (anchor == (int)m_anchors.size())
+		m_anchors.push_back({ false, 0, 0, 0, {} });
+
+	SetAnchor(anchor, state, false);
+	return anchor;
+}
+
+void ChunckStreamer::RemoveAnchor(int anchor)
+{
+	SetAnchor(anchor, { false, 0, 0, 0, {} }, true);
+	EvictStaging();
+}
+
+void ChunckStreamer::SetAnchor(int anchor, const Anchor & state, bool stageLeaving)
+{
+	const Anchor old = m_anchors[anchor];
+	m_anchors[anchor] = state;
+
+	//Release chuncks leaving the load radius of every anchor
+	for (const glm::ivec2 & offset : old.spiral)
+	{
+		int x = old.originX + offset.x;
+		int z = old.originZ + offset.y;
+		Chunck * chunck = Get(x, z);
+		if (chunck && !Resident(x, z))
+		{
+			Set(x, z, nullptr);
+			if (stageLeaving)
+				StageChunck(chunck);
+			else
+				DeleteChunck(chunck);
+		}
+	}
+
+	//Load chuncks entering the load radius, closest first
+	const glm::ivec2 neighbours[4] = { glm::ivec2(1, 0), glm::ivec2(-1, 0), glm::ivec2(0, 1), glm::ivec2(0, -1) };
+	for (const glm::ivec2 & offset : state.spiral)
+	{
+		int x = state.originX + offset.x;
+		int z = state.originZ + offset.y;
+		if (InsideAnchor(old, x, z) || Get(x, z))
+			continue;
+
+		LoadChunck(x, z, DistanceToCenter(x, z));
+
+		//Chuncks on the previous boundary get new neighbours
+		for (const glm::ivec2 & neighbour : neighbours)
+		{
+			Chunck * chunck = Get(x + neighbour.x, z + neighbour.y);
+			if (chunck)
+				for (int y = 0; y < Chunck::height; ++y)
+					UpdateSubChunckMesh(chunck->GetSubChunck(y));
+		}
+	}
+}
+
+void ChunckStreamer::Move(int anchor, int dx, int dz)
+{
+	Anchor state = m_anchors[anchor];
+	state.originX += dx;
+	state.originZ += dz;
+	SetAnchor(anchor, state, true);
+
+	EvictStaging();
+}
+
+void ChunckStreamer::Recenter(int anchor, int originX, int originZ)
+{
+	if (originX == m_anchors[anchor].originX && originZ == m_anchors[anchor].originZ)
+		return;
+
+	//Every queued generation is either obsolete or queued again below with its new priority
+	m_chunckGenerator->CancelBlocks();
+	m_requested.clear();
+
+	//Keeps the overlapping chuncks, releases the others and requests the new ones
+	Anchor state = m_anchors[anchor];
+	state.originX = originX;
+	state.originZ = originZ;
+	SetAnchor(anchor, state, false);
+	m_chunckGenerator->CancelMeshes([this](SubChunck * subChunck) { return !Resident(subChunck->Position().x, subChunck->Position().z); });
+
+	//Cells whose generation was cancelled, the ones requested above stay in m_requested and are skipped
+	for (const Anchor & other : m_anchors)
+		for (const glm::ivec2 & offset : other.spiral)
+		{
+			int x = other.originX + offset.x;
+			int z = other.originZ + offset.y;
+			if (!Get(x, z))
+				LoadChunck(x, z, DistanceToCenter(x, z));
+		}
+}
+
+void ChunckStreamer::Resize(int anchor, int size)
+{
+	if (size == m_anchors[anchor].size || size < 1)
+		return;
+
+	//Keeps the same center, chuncks leaving are staged to be reused if the radius grows back
+	Anchor state = m_anchors[anchor];
+	state.originX += (state.size - size) / 2;
+	state.originZ += (state.size - size) / 2;
+	state.size = size;
+	state.spiral = BuildSpiral(size);
+	SetAnchor(anchor, state, true);
+
+	EvictStaging();
+}
+
+void ChunckStreamer::LoadChunck(int x, int z, float priority)
+{
+	std::pair<int, int> key = std::make_pair(x, z);
+
+	//Staged and cached chuncks enter the world instantly
+	std::map<std::pair<int, int>, Chunck*>::iterator it = m_staging.find(key);
+	if (it == m_staging.end())
+	{
+		Chunck * restored = RestoreChunck(x, z);
+		if (restored)
+			it = m_staging.insert(std::make_pair(key, restored)).first;
+	}
+
+	if (it != m_staging.end())
+	{
+		it->second->SetEnabled(true);
+		for (int y = 0; y < Chunck::height; ++y)
+			if (it->second->GetSubChunck(y)->PendingUpdate())
+				ScheduleUpdate(it->second->GetSubChunck(y));
+		m_waitingFirstGen.push_back(it->second);
+		Set(x, z, it->second);
+		m_staging.erase(it);
+	}
+	//Already in the generator queue, it will be added to the world when generated
+	else if (m_requested.insert(key).second)
+		m_chunckGenerator->GenerateBlocks(x, z, priority);
+}
+
+Chunck * ChunckStreamer::RestoreChunck(int x, int z)
+{
+	//Memory only, the chuncks on disk are decoded by the generator thread
+	if (!m_cache.Contains(x, z))
+		return nullptr;
+
+	Chunck * chunck = m_chunckPool->Acquire(x, z);
+	if (m_cache.Restore(chunck))
+	{
+		ReplayEdits(chunck);
+		return chunck;
+	}
+
+	std::cerr << "ERROR: ChunckStreamer::RestoreChunck corrupted chunck " << x << " " << z << std::endl;
+	m_chunckPool->Release(chunck);
+	return nullptr;
+}
+
+void ChunckStreamer::PrefetchChunck(int x, int z, float priority)
+{
+	std::pair<int, int> key = std::make_pair(x, z);
+	if (m_staging.find(key) != m_staging.end() || Get(x, z))
+		return;
+
+	Chunck * restored = RestoreChunck(x, z);
+	if (restored)
+		m_staging[key] = restored;
+	else if (m_requested.insert(key).second)
+		m_chunckGenerator->GenerateBlocks(x, z, priority);
+}
+
+void ChunckStreamer::Prefetch(int anchor, glm::vec2 direction)
+{
+	const Anchor & state = m_anchors[anchor];
+
+	//Generates the cells that would enter the load radius if it moved in the given direction (in chuncks), the further the more rings
+	int depthX = std::min((int)std::ceil(std::abs(direction.x) - 0.5f), maxPrefetchDepth);
+	int depthZ = std::min((int)std::ceil(std::abs(direction.y) - 0.5f), maxPrefetchDepth);
+	int signX = direction.x > 0 ? 1 : -1;
+	int signZ = direction.y > 0 ? 1 : -1;
+
+	for (int d = 1; d <= depthX; ++d)
+	{
+		Anchor previous = state;
+		previous.originX += signX * (d - 1);
+		for (const glm::ivec2 & offset : state.spiral)
+		{
+			int x = previous.originX + signX + offset.x;
+			int z = previous.originZ + offset.y;
+			if (!InsideAnchor(previous, x, z) && !Resident(x, z))
+				PrefetchChunck(x, z, (float)(state.size + d));
+		}
+	}
+	for (int d = 1; d <= depthZ; ++d)
+	{
+		Anchor previous = state;
+		previous.originZ += signZ * (d - 1);
+		for (const glm::ivec2 & offset : state.spiral)
+		{
+			int x = previous.originX + offset.x;
+			int z = previous.originZ + signZ + offset.y;
+			if (!InsideAnchor(previous, x, z) && !Resident(x, z))
+				PrefetchChunck(x, z, (float)(state.size + d));
+		}
+	}
+
+	EvictStaging();
+}
+
+void ChunckStreamer::EvictStaging()
+{
+	//Forget staged chuncks that are too far from every radius
+	for (std::map<std::pair<int, int>, Chunck*>::iterator it = m_staging.begin(); it != m_staging.end();)
+	{
+		if (DistanceOutside(it->first.first, it->first.second) > maxPrefetchDepth + 1)
+		{
+			DeleteChunck(it->second);
+			it = m_staging.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void ChunckStreamer::Set(int x, int z, Chunck* chunck)
+{
+	//Keeps the neighbours pointers of the chuncks around the cell up to date
+	const SubChunck::Face faces[4] = { SubChunck::right, SubChunck::left, SubChunck::front, SubChunck::back };
+	const glm::ivec2 offsets[4] = { glm::ivec2(1, 0), glm::ivec2(-1, 0), glm::ivec2(0, 1), glm::ivec2(0, -1) };
+
+	Chunck * previous = m_chuncks.Get(x, z);
+	if (previous == chunck)
+		return;
+
+	//Only the chuncks in the map keep their records in the GPU culler
+	if (previous)
+		previous->SetResident(false);
+	if (chunck)
+		chunck->SetResident(true);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		Chunck * neighbour = m_chuncks.Get(x + offsets[i].x, z + offsets[i].y);
+		if (previous)
+			previous->SetNeighbour(faces[i], nullptr);
+		if (chunck)
+			chunck->SetNeighbour(faces[i], neighbour);
+		if (neighbour)
+			neighbour->SetNeighbour(faces[i] ^ 1, chunck);
+	}
+
+	m_chuncks.Set(x, z, chunck);
+}
+
+Chunck * ChunckStreamer::Get(int x, int z) const
+{
+	return m_chuncks.Get(x, z);
+}
+
+const ChunckMap & ChunckStreamer::Chuncks() const { return m_chuncks; }
+ChunckCache & ChunckStreamer::Cache() { return m_cache; }
+MeshCache & ChunckStreamer::Meshes() { return m_chunckGenerator->Meshes(); }
+MeshArena & ChunckStreamer::Arena() { return m_chunckPool->Arena(); }
+GpuCuller & ChunckStreamer::Culler() { return m_chunckPool->Culler(); }
+int ChunckStreamer::Size(int anchor) const { return m_anchors[anchor].size; }
+int ChunckStreamer::OriginX(int anchor) const { return m_anchors[anchor].originX; }
+int ChunckStreamer::OriginZ(int anchor) const { return m_anchors[anchor].originZ; }
+int ChunckStreamer::ResidentCount() const { return m_chuncks.Count(); }
+int ChunckStreamer::StagedCount() const { return (int)m_staging.size(); }
+int ChunckStreamer::ActiveCount() const { return (int)m_active.size(); }
+int ChunckStreamer::GeneratorBacklog() const { return m_chunckGenerator->BlocksBacklog() + m_chunckGenerator->MeshBacklog(); }
+float ChunckStreamer::MeshTime() const { return m_chunckGenerator->MeshTime(); }
+float ChunckStreamer::GenerationTime() const { return m_chunckGenerator->BlocksTime(); }
+float ChunckStreamer::LoadTime() const { return m_regions.LoadTime(); }
+
+ChunckStreamer::~ChunckStreamer()
+{
+	//Saves the chuncks still in memory, the region store writes them before being destroyed
+	for (int i = 0; i < m_chuncks.Capacity(); ++i)
+	{
+		Chunck * chunck = m_chuncks.At(i);
+		if (chunck && chunck->LateGenerated() && chunck->Modified())
+		{
+			std::vector<uint8_t> data;
+			chunck->Compress(data);
+			m_regions.Save(chunck->Position().x, chunck->Position().z, data);
+		}
+	}
+	for (std::pair<const std::pair<int, int>, Chunck*> & staged : m_staging)
+		if (staged.second->LateGenerated() && staged.second->Modified())
+		{
+			std::vector<uint8_t> data;
+			staged.second->Compress(data);
+			m_regions.Save(staged.first.first, staged.first.second, data);
+		}
+
+	delete m_chunckGenerator;
+	delete m_chunckPool;
+}
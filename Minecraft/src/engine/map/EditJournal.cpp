@@ -0,0 +1,239 @@
+#include "engine/map/EditJournal.h"
+#include "engine/map/SubChunck.h"
+#include "util/MoreMath.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const float EditJournal::syncDelay = 0.5f;
+
+namespace
+{
+	bool Exists(const std::string & path)
+	{
+		FILE * file = fopen(path.c_str(), "rb");
+		if (file)
+			fclose(file);
+		return file != nullptr;
+	}
+}
+
+EditJournal::EditJournal(const std::string & path) :
+	m_path(path),
+	m_oldPath(path + ".old"),
+	m_file(nullptr),
+	m_size(0)
+{
+	//Crash while merging: the merged journal is complete, it was synced before the others were removed
+	std::string mergedPath = m_path + ".tmp";
+	if (!Exists(m_path) && Exists(mergedPath))
+		std::rename(mergedPath.c_str(), m_path.c_str());
+	std::remove(mergedPath.c_str());
+
+	//Crash while compacting: the previous journal edits may not be in the region files
+	Read(m_oldPath);
+	Read(m_path);
+
+	if (Exists(m_oldPath))
+	{
+		m_file = fopen(mergedPath.c_str(), "wb");
+		for (const std::pair<const uint64_t, std::vector<Edit>> & chunck : m_replay)
+			for (const Edit & edit : chunck.second)
+				Write(edit);
+		Flush(m_file, m_buffer);
+		m_buffer.clear();
+		fclose(m_file);
+
+		std::remove(m_oldPath.c_str());
+		std::remove(m_path.c_str());
+		std::rename(mergedPath.c_str(), m_path.c_str());
+	}
+
+	m_file = fopen(m_path.c_str(), "ab");
+	if (!m_file)
+		std::cerr << "ERROR: EditJournal could not open " << m_path << std::endl;
+
+	m_syncThread = new std::thread(&EditJournal::UpdateSync, this);
+}
+
+void EditJournal::Read(const std::string & path)
+{
+	FILE * file = fopen(path.c_str(), "rb");
+	if (!file)
+		return;
+
+	//A record cut by a crash is ignored
+	uint8_t record[recordSize];
+	while (fread(record, 1, recordSize, file) == recordSize)
+	{
+		int32_t values[4];
+		for (int i = 0; i < 3; ++i)
+			values[i] = (int32_t)(record[4 * i] | (record[4 * i + 1] << 8) | (record[4 * i + 2] << 16) | ((uint32_t)record[4 * i + 3] << 24));
+		values[3] = (int32_t)(record[14] | (record[15] << 8) | (record[16] << 16) | ((uint32_t)record[17] << 24));
+
+		Edit edit = { glm::ivec3(values[0], values[1], values[2]), record[12], record[13], (uint32_t)values[3] };
+		uint64_t key = ChunckMap::Key(FloorDiv(edit.position.x, SubChunck::size), FloorDiv(edit.position.z, SubChunck::size));
+		m_replay[key].push_back(edit);
+		m_edited.insert(key);
+		++m_size;
+	}
+	fclose(file);
+}
+
+void EditJournal::Write(const Edit & edit)
+{
+	//Little endian x, y, z, old type, new type, tick
+	const uint32_t values[3] = { (uint32_t)edit.position.x, (uint32_t)edit.position.y, (uint32_t)edit.position.z };
+	for (uint32_t value : values)
+		for (int i = 0; i < 4; ++i)
+			m_buffer.push_back((uint8_t)(value >> (8 * i)));
+	m_buffer.push_back(edit.oldType);
+	m_buffer.push_back(edit.newType);
+	for (int i = 0; i < 4; ++i)
+		m_buffer.push_back((uint8_t)(edit.tick >> (8 * i)));
+}
+
+void EditJournal::Flush(FILE * file, const std::vector<uint8_t> & buffer)
+{
+	if (!file || buffer.empty())
+		return;
+
+	fwrite(buffer.data(), 1, buffer.size(), file);
+	fflush(file);
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+}
+
+void EditJournal::Append(const Edit & edit)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Write(edit);
+	m_edited.insert(ChunckMap::Key(FloorDiv(edit.position.x, SubChunck::size), FloorDiv(edit.position.z, SubChunck::size)));
+	++m_size;
+}
+
+std::vector<EditJournal::Edit> EditJournal::TakeReplay(int chunckX, int chunckZ)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<Edit> edits;
+	std::unordered_map<uint64_t, std::vector<Edit>>::iterator it = m_replay.find(ChunckMap::Key(chunckX, chunckZ));
+	if (it != m_replay.end())
+	{
+		edits.swap(it->second);
+		m_replay.erase(it);
+	}
+	return edits;
+}
+
+std::vector<glm::ivec2> EditJournal::EditedChuncks() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<glm::ivec2> chuncks;
+	for (uint64_t key : m_edited)
+		chuncks.push_back(glm::ivec2(ChunckMap::KeyX(key), ChunckMap::KeyZ(key)));
+	return chuncks;
+}
+
+void EditJournal::Compact(std::function<void()> waitSnapshots)
+{
+	std::lock_guard<std::mutex> fileLock(m_fileMtx);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_compacting || !m_file)
+		return;
+
+	//The previous journal is kept until the snapshots of its chuncks are on disk
+	Flush(m_file, m_buffer);
+	m_buffer.clear();
+	fclose(m_file);
+	std::rename(m_path.c_str(), m_oldPath.c_str());
+	m_file = fopen(m_path.c_str(), "wb");
+
+	//Edits of chuncks not loaded since the startup are not in any snapshot
+	m_edited.clear();
+	m_size = 0;
+	for (const std::pair<const uint64_t, std::vector<Edit>> & chunck : m_replay)
+	{
+		for (const Edit & edit : chunck.second)
+			Write(edit);
+		m_edited.insert(chunck.first);
+		m_size += (int)chunck.second.size();
+	}
+
+	m_waitSnapshots = waitSnapshots;
+	m_compacting = true;
+	m_condition.notify_all();
+}
+
+void EditJournal::UpdateSync()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait_for(lock, std::chrono::duration<float>(syncDelay), [this]() { return m_quitting || m_compacting; });
+		}
+
+		//Same locking order as Compact, the buffer is written to the file it was appended for
+		std::unique_lock<std::mutex> fileLock(m_fileMtx);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		std::vector<uint8_t> buffer;
+		buffer.swap(m_buffer);
+		bool quitting = m_quitting;
+		std::function<void()> waitSnapshots = m_compacting ? m_waitSnapshots : nullptr;
+		lock.unlock();
+
+		//Edits are appended while the file is synced
+		Flush(m_file, buffer);
+		fileLock.unlock();
+
+		if (waitSnapshots)
+		{
+			waitSnapshots();
+			std::remove(m_oldPath.c_str());
+
+			lock.lock();
+			m_compacting = false;
+			m_waitSnapshots = nullptr;
+			lock.unlock();
+		}
+
+		if (quitting)
+			break;
+	}
+}
+
+bool EditJournal::Compacting() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_compacting;
+}
+
+int EditJournal::Size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_size;
+}
+
+EditJournal::~EditJournal()
+{
+	m_mutex.lock();
+	m_quitting = true;
+	m_condition.notify_all();
+	m_mutex.unlock();
+
+	m_syncThread->join();
+	delete m_syncThread;
+
+	if (m_file)
+		fclose(m_file);
+}
@@ -0,0 +1,364 @@
+#include "engine/map/MeshCache.h"
+#include "engine/map/SubChunck.h"
+#include "engine/map/Chunck.h"
+#include "engine/map/ChunckPool.h"
+#include "engine/map/ChunckMap.h"
+#include "util/MoreMath.h"
+
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const float MeshCache::flushDelay = 1.f;
+
+namespace
+{
+	const size_t compactSlack = 4 << 20;//Bytes of replaced meshes a region file keeps before it is written again without them
+}
+
+MeshCache::MeshCache(const std::string & directory) :
+	m_directory(directory),
+	m_enabled(false),
+	m_hits(0),
+	m_misses(0),
+	m_timeSaved(0.f)
+{
+	//Creates the parent directories too, the cache may be created before the world directory
+	for (size_t i = 0; i != std::string::npos; i = directory.find('/', i + 1))
+		if (i > 0)
+		{
+#ifdef _WIN32
+			_mkdir(directory.substr(0, i).c_str());
+#else
+			mkdir(directory.substr(0, i).c_str(), 0755);
+#endif
+		}
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+	m_writeThread = new std::thread(&MeshCache::UpdateWrites, this);
+}
+
+std::string MeshCache::RegionPath(int regionX, int regionZ) const
+{
+	return m_directory + "/m." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".meshes";
+}
+
+int MeshCache::EntryIndex(glm::ivec3 position)
+{
+	return (FloorMod(position.x, regionSize) * regionSize + FloorMod(position.z, regionSize)) * Chunck::height + position.y;
+}
+
+size_t MeshCache::TableSize()
+{
+	return (size_t)regionSize * regionSize * Chunck::height * sizeof(Entry);
+}
+
+bool MeshCache::ValidFile(const MappedFile & file)
+{
+	//Files of another meshing, vertex format or chunck height are ignored and written again
+	if (file.Size() < sizeof(Header) + TableSize())
+		return false;
+	const Header * header = (const Header *)file.Data();
+	return std::memcmp(header->magic, "MCGM", 4) == 0 && header->version == version && header->height == (uint32_t)Chunck::height && header->vertexSize == sizeof(Mesh::Vertex);
+}
+
+MeshCache::Region * MeshCache::GetRegion(uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(m_regionsMtx);
+
+	std::unordered_map<uint64_t, Region *>::iterator it = m_regions.find(key);
+	if (it != m_regions.end())
+		return it->second;
+
+	Region * region = new Region();
+	region->valid = region->file.Open(RegionPath(ChunckMap::KeyX(key), ChunckMap::KeyZ(key))) && ValidFile(region->file);
+	if (!region->valid)
+		region->file.Close();
+	m_regions[key] = region;
+	return region;
+}
+
+void MeshCache::Stage(SubChunck * subChunck, const Mesh::Vertex * vertices, uint32_t opaqueCount, uint32_t transparentCount)
+{
+	//One copy from the saved vertices to the upload ring, the vectors are only used when the ring is full
+	MeshArena & arena = subChunck->m_pool->Arena();
+	subChunck->m_stagedOpaque = arena.Stage(vertices, opaqueCount);
+	if (subChunck->m_stagedOpaque.size > 0)
+		subChunck->m_verticesOpaque.clear();
+	else
+		subChunck->m_verticesOpaque.assign(vertices, vertices + opaqueCount);
+
+	subChunck->m_stagedTransparent = arena.Stage(vertices + opaqueCount, transparentCount);
+	if (subChunck->m_stagedTransparent.size > 0)
+		subChunck->m_verticesTransparent.clear();
+	else
+		subChunck->m_verticesTransparent.assign(vertices + opaqueCount, vertices + opaqueCount + transparentCount);
+}
+
+bool MeshCache::Load(SubChunck * subChunck, uint64_t hash, float & meshTime)
+{
+	glm::ivec3 pos = subChunck->Position();
+	uint64_t key = ChunckMap::Key(FloorDiv(pos.x, regionSize), FloorDiv(pos.z, regionSize));
+	int index = EntryIndex(pos);
+
+	//Meshes not written yet, newer than the file
+	{
+		std::lock_guard<std::mutex> lock(m_writesMtx);
+		const Write * write = nullptr;
+		for (const std::unordered_map<uint64_t, RegionWrites> * writes : { &m_pendingWrites, &m_currentWrites })
+		{
+			std::unordered_map<uint64_t, RegionWrites>::const_iterator region = writes->find(key);
+			RegionWrites::const_iterator it;
+			if (region != writes->end() && (it = region->second.find(index)) != region->second.end())
+			{
+				write = &it->second;
+				break;
+			}
+		}
+
+		if (write)
+		{
+			if (write->hash != hash)
+			{
+				++m_misses;
+				return false;
+			}
+			Stage(subChunck, write->vertices.data(), write->opaqueCount, (uint32_t)write->vertices.size() - write->opaqueCount);
+			meshTime = write->meshTime;
+			++m_hits;
+			return true;
+		}
+	}
+
+	Region * region = GetRegion(key);
+	std::lock_guard<std::mutex> lock(region->mutex);
+	const Entry * entry = region->valid ? (const Entry *)(region->file.Data() + sizeof(Header)) + index : nullptr;
+	if (!entry || entry->hash != hash ||
+		(size_t)entry->offset + ((size_t)entry->opaqueCount + entry->transparentCount) * sizeof(Mesh::Vertex) > region->file.Size())
+	{
+		++m_misses;
+		return false;
+	}
+
+	//The vertices are in the format uploaded to the GPU
+	Stage(subChunck, (const Mesh::Vertex *)(region->file.Data() + entry->offset), entry->opaqueCount, entry->transparentCount);
+	meshTime = entry->meshTime;
+	++m_hits;
+	return true;
+}
+
+void MeshCache::Save(const SubChunck * subChunck, uint64_t hash, float meshTime)
+{
+	Write write;
+	write.hash = hash;
+	write.meshTime = meshTime;
+	write.opaqueCount = (uint32_t)subChunck->m_verticesOpaque.size();
+	write.vertices.reserve(subChunck->m_verticesOpaque.size() + subChunck->m_verticesTransparent.size());
+	write.vertices.insert(write.vertices.end(), subChunck->m_verticesOpaque.begin(), subChunck->m_verticesOpaque.end());
+	write.vertices.insert(write.vertices.end(), subChunck->m_verticesTransparent.begin(), subChunck->m_verticesTransparent.end());
+
+	glm::ivec3 pos = subChunck->Position();
+	std::lock_guard<std::mutex> lock(m_writesMtx);
+	m_pendingWrites[ChunckMap::Key(FloorDiv(pos.x, regionSize), FloorDiv(pos.z, regionSize))][EntryIndex(pos)] = std::move(write);
+}
+
+void MeshCache::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_writesMtx);
+	m_flushRequested = true;
+	m_writesCondition.notify_all();
+	m_writesCondition.wait(lock, [this]() { return m_pendingWrites.empty() && m_currentWrites.empty(); });
+}
+
+void MeshCache::UpdateWrites()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(m_writesMtx);
+		m_writesCondition.wait_for(lock, std::chrono::duration<float>(flushDelay), [this]() { return m_quitting || m_flushRequested; });
+		if (m_pendingWrites.empty())
+		{
+			m_flushRequested = false;
+			m_writesCondition.notify_all();
+			if (m_quitting)
+				break;
+			continue;
+		}
+		m_currentWrites.swap(m_pendingWrites);
+		lock.unlock();
+
+		//Each region file is opened once for all its meshes, readers still see the meshes being written
+		for (const std::pair<const uint64_t, RegionWrites> & region : m_currentWrites)
+			WriteRegion(region.first, region.second);
+
+		lock.lock();
+		m_currentWrites.clear();
+		if (m_pendingWrites.empty())
+			m_flushRequested = false;
+		m_writesCondition.notify_all();
+	}
+}
+
+void MeshCache::WriteRegion(uint64_t key, const RegionWrites & writes)
+{
+	Region * region = GetRegion(key);
+	std::lock_guard<std::mutex> lock(region->mutex);
+
+	std::string path = RegionPath(ChunckMap::KeyX(key), ChunckMap::KeyZ(key));
+	const size_t tableEnd = sizeof(Header) + TableSize();
+	std::vector<Entry> table(TableSize() / sizeof(Entry), Entry());
+	size_t fileSize = tableEnd;
+	if (region->valid)
+	{
+		std::memcpy(table.data(), region->file.Data() + sizeof(Header), TableSize());
+		fileSize = region->file.Size();
+	}
+
+	//Replaced meshes stay in the file until they outweigh the live ones
+	size_t appended = 0;
+	for (const std::pair<const int, Write> & write : writes)
+		appended += write.second.vertices.size() * sizeof(Mesh::Vertex);
+	size_t live = appended;
+	for (size_t i = 0; i < table.size(); ++i)
+		if (writes.find((int)i) == writes.end())
+			live += ((size_t)table[i].opaqueCount + table[i].transparentCount) * sizeof(Mesh::Vertex);
+
+	if (!region->valid || fileSize + appended - tableEnd > 2 * live + compactSlack)
+	{
+		//Written aside with the live meshes only then renamed over the region, a crash leaves the previous file whole
+		std::string tmpPath = path + ".tmp";
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cerr << "ERROR: MeshCache::WriteRegion could not open " << tmpPath << std::endl;
+			return;
+		}
+
+		std::vector<Entry> newTable(table.size(), Entry());
+		size_t offset = tableEnd;
+		file.seekp(tableEnd);
+		for (size_t i = 0; i < table.size(); ++i)
+		{
+			size_t bytes = ((size_t)table[i].opaqueCount + table[i].transparentCount) * sizeof(Mesh::Vertex);
+			if ((table[i].hash == 0 && bytes == 0) || writes.find((int)i) != writes.end() || table[i].offset + bytes > fileSize)
+				continue;
+			file.write((const char *)region->file.Data() + table[i].offset, bytes);
+			newTable[i] = table[i];
+			newTable[i].offset = (uint32_t)offset;
+			offset += bytes;
+		}
+		for (const std::pair<const int, Write> & write : writes)
+		{
+			file.write((const char *)write.second.vertices.data(), write.second.vertices.size() * sizeof(Mesh::Vertex));
+			newTable[write.first] = { write.second.hash, (uint32_t)offset, write.second.opaqueCount, (uint32_t)write.second.vertices.size() - write.second.opaqueCount, write.second.meshTime };
+			offset += write.second.vertices.size() * sizeof(Mesh::Vertex);
+		}
+
+		Header header;
+		std::memcpy(header.magic, "MCGM", 4);
+		header.version = version;
+		header.height = Chunck::height;
+		header.vertexSize = sizeof(Mesh::Vertex);
+		file.seekp(0);
+		file.write((const char *)&header, sizeof(Header));
+		file.write((const char *)newTable.data(), TableSize());
+		file.close();
+
+		//The file cannot be replaced while it is mapped
+		region->file.Close();
+		region->valid = false;
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+			std::cerr << "ERROR: MeshCache::WriteRegion could not rename " << tmpPath << std::endl;
+	}
+	else
+	{
+		//The file cannot be written while it is mapped
+		region->file.Close();
+		region->valid = false;
+
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		if (file)
+		{
+			//The meshes are appended before the table points to them, a crash in between keeps the previous meshes
+			file.seekp(fileSize);
+			for (const std::pair<const int, Write> & write : writes)
+			{
+				file.write((const char *)write.second.vertices.data(), write.second.vertices.size() * sizeof(Mesh::Vertex));
+				table[write.first] = { write.second.hash, (uint32_t)fileSize, write.second.opaqueCount, (uint32_t)write.second.vertices.size() - write.second.opaqueCount, write.second.meshTime };
+				fileSize += write.second.vertices.size() * sizeof(Mesh::Vertex);
+			}
+			file.flush();
+
+			for (const std::pair<const int, Write> & write : writes)
+			{
+				file.seekp(sizeof(Header) + write.first * sizeof(Entry));
+				file.write((const char *)&table[write.first], sizeof(Entry));
+			}
+			file.close();
+		}
+		else
+			std::cerr << "ERROR: MeshCache::WriteRegion could not open " << path << std::endl;
+	}
+
+	region->valid = region->file.Open(path) && ValidFile(region->file);
+	if (!region->valid)
+		region->file.Close();
+}
+
+void MeshCache::AddTimeSaved(float seconds)
+{
+	std::lock_guard<std::mutex> lock(m_timeMtx);
+	m_timeSaved += seconds;
+}
+
+float MeshCache::HitRate() const
+{
+	int total = m_hits + m_misses;
+	return total > 0 ? (float)m_hits / total : 0.f;
+}
+
+float MeshCache::TimeSaved() const
+{
+	std::lock_guard<std::mutex> lock(m_timeMtx);
+	return m_timeSaved;
+}
+
+int MeshCache::PendingWrites()
+{
+	std::lock_guard<std::mutex> lock(m_writesMtx);
+	int count = 0;
+	for (const std::pair<const uint64_t, RegionWrites> & region : m_pendingWrites)
+		count += (int)region.second.size();
+	for (const std::pair<const uint64_t, RegionWrites> & region : m_currentWrites)
+		count += (int)region.second.size();
+	return count;
+}
+
+void MeshCache::SetEnabled(bool state) { m_enabled = state; }
+bool MeshCache::Enabled() const { return m_enabled; }
+
+MeshCache::~MeshCache()
+{
+	m_writesMtx.lock();
+	m_quitting = true;
+	m_writesCondition.notify_all();
+	m_writesMtx.unlock();
+
+	m_writeThread->join();
+	delete m_writeThread;
+
+	for (std::pair<const uint64_t, Region *> & region : m_regions)
+		delete region.second;
+}
@@ -0,0 +1,313 @@
+#include "engine/map/RegionStore.h"
+#include "engine/map/Chunck.h"
+#include "util/MoreMath.h"
+
+#include <fstream>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const float RegionStore::flushDelay = 1.f;
+
+namespace
+{
+	const size_t compactSlack = 1 << 20;//Bytes of replaced chuncks a region file keeps before it is written again without them
+}
+
+RegionStore::RegionStore(const std::string & directory) :
+	m_directory(directory),
+	m_loadTime(0.f)
+{
+#ifdef _WIN32
+	_mkdir(m_directory.c_str());
+#else
+	mkdir(m_directory.c_str(), 0755);
+#endif
+	m_writeThread = new std::thread(&RegionStore::UpdateWrites, this);
+}
+
+std::string RegionStore::RegionPath(int regionX, int regionZ) const
+{
+	return m_directory + "/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".region";
+}
+
+int RegionStore::EntryIndex(int x, int z)
+{
+	return FloorMod(x, regionSize) * regionSize + FloorMod(z, regionSize);
+}
+
+bool RegionStore::ValidHeader(const Header & header)
+{
+	//Files written with another blocks layout or chunck height are ignored and overwritten
+	return std::memcmp(header.magic, "MCGR", 4) == 0 && header.version == version && header.layout == (SubChunck::MortonLayout() ? 1u : 0u) && header.height == (uint32_t)Chunck::height;
+}
+
+RegionStore::Region * RegionStore::GetRegion(int regionX, int regionZ)
+{
+	std::lock_guard<std::mutex> lock(m_regionsMtx);
+
+	uint64_t key = ChunckMap::Key(regionX, regionZ);
+	std::unordered_map<uint64_t, Region *>::iterator it = m_regions.find(key);
+	if (it != m_regions.end())
+		return it->second;
+
+	Region * region = new Region();
+	region->valid = region->file.Open(RegionPath(regionX, regionZ)) && region->file.Size() >= sizeof(Header) && ValidHeader(*(const Header *)region->file.Data());
+	if (!region->valid)
+		region->file.Close();
+	m_regions[key] = region;
+	return region;
+}
+
+bool RegionStore::Contains(int x, int z)
+{
+	uint64_t key = ChunckMap::Key(x, z);
+	{
+		std::lock_guard<std::mutex> lock(m_writesMtx);
+		if (m_pendingWrites.find(key) != m_pendingWrites.end() || m_currentWrites.find(key) != m_currentWrites.end())
+			return true;
+	}
+
+	Region * region = GetRegion(FloorDiv(x, regionSize), FloorDiv(z, regionSize));
+	std::lock_guard<std::mutex> lock(region->mutex);
+	return region->valid && ((const Header *)region->file.Data())->entries[EntryIndex(x, z)].size != 0;
+}
+
+bool RegionStore::Load(Chunck * chunck)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	glm::ivec3 pos = chunck->Position();
+	uint64_t key = ChunckMap::Key(pos.x, pos.z);
+	bool loaded = false;
+	bool found = false;
+
+	//Chuncks not written yet
+	{
+		std::lock_guard<std::mutex> lock(m_writesMtx);
+		const std::vector<uint8_t> * data = nullptr;
+		std::unordered_map<uint64_t, std::vector<uint8_t>>::iterator it = m_pendingWrites.find(key);
+		if (it != m_pendingWrites.end())
+			data = &it->second;
+		else if ((it = m_currentWrites.find(key)) != m_currentWrites.end())
+			data = &it->second;
+
+		if (data)
+		{
+			found = true;
+			loaded = chunck->Decompress(data->data(), data->size());
+		}
+	}
+
+	//Decodes from the mapped file without copy
+	if (!found)
+	{
+		Region * region = GetRegion(FloorDiv(pos.x, regionSize), FloorDiv(pos.z, regionSize));
+		std::lock_guard<std::mutex> lock(region->mutex);
+		if (region->valid)
+		{
+			Entry entry = ((const Header *)region->file.Data())->entries[EntryIndex(pos.x, pos.z)];
+			if (entry.size != 0 && (size_t)entry.offset + entry.size <= region->file.Size())
+				loaded = chunck->Decompress(region->file.Data() + entry.offset, entry.size);
+		}
+	}
+
+	if (loaded)
+	{
+		float time = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+		m_loadTime = 0.95f * m_loadTime + 0.05f * time;
+	}
+	return loaded;
+}
+
+void RegionStore::Save(int x, int z, const std::vector<uint8_t> & data)
+{
+	std::lock_guard<std::mutex> lock(m_writesMtx);
+	m_pendingWrites[ChunckMap::Key(x, z)] = data;
+}
+
+void RegionStore::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_writesMtx);
+	m_flushRequested = true;
+	m_writesCondition.notify_all();
+	m_writesCondition.wait(lock, [this]() { return m_pendingWrites.empty() && m_currentWrites.empty(); });
+}
+
+void RegionStore::UpdateWrites()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(m_writesMtx);
+		m_writesCondition.wait_for(lock, std::chrono::duration<float>(flushDelay), [this]() { return m_quitting || m_flushRequested; });
+		if (m_pendingWrites.empty())
+		{
+			m_flushRequested = false;
+			m_writesCondition.notify_all();
+			if (m_quitting)
+				break;
+			continue;
+		}
+		m_currentWrites.swap(m_pendingWrites);
+		lock.unlock();
+
+		//Each region file is opened once for all its chuncks, readers still see the chuncks being written
+		std::map<std::pair<int, int>, std::vector<std::pair<int, const std::vector<uint8_t> *>>> regions;
+		for (const std::pair<const uint64_t, std::vector<uint8_t>> & write : m_currentWrites)
+		{
+			int x = ChunckMap::KeyX(write.first);
+			int z = ChunckMap::KeyZ(write.first);
+			regions[std::make_pair(FloorDiv(x, regionSize), FloorDiv(z, regionSize))].push_back(std::make_pair(EntryIndex(x, z), &write.second));
+		}
+		for (const std::pair<const std::pair<int, int>, std::vector<std::pair<int, const std::vector<uint8_t> *>>> & region : regions)
+			WriteRegion(region.first.first, region.first.second, region.second);
+
+		lock.lock();
+		m_currentWrites.clear();
+		if (m_pendingWrites.empty())
+			m_flushRequested = false;
+		m_writesCondition.notify_all();
+	}
+}
+
+void RegionStore::WriteRegion(int regionX, int regionZ, const std::vector<std::pair<int, const std::vector<uint8_t> *>> & chuncks)
+{
+	Region * region = GetRegion(regionX, regionZ);
+	std::lock_guard<std::mutex> lock(region->mutex);
+
+	std::string path = RegionPath(regionX, regionZ);
+	Header * header = new Header();
+	size_t fileSize = sizeof(Header);
+	if (region->valid)
+	{
+		*header = *(const Header *)region->file.Data();
+		fileSize = region->file.Size();
+	}
+	else
+	{
+		std::memcpy(header->magic, "MCGR", 4);
+		header->version = version;
+		header->layout = SubChunck::MortonLayout() ? 1 : 0;
+		header->height = Chunck::height;
+	}
+
+	//Replaced chuncks stay in the file until they outweigh the live ones
+	std::vector<bool> written(regionSize * regionSize, false);
+	size_t appended = 0;
+	for (const std::pair<int, const std::vector<uint8_t> *> & chunck : chuncks)
+	{
+		written[chunck.first] = true;
+		appended += chunck.second->size();
+	}
+	size_t live = appended;
+	for (int i = 0; i < regionSize * regionSize; ++i)
+		if (!written[i])
+			live += header->entries[i].size;
+
+	if (!region->valid || fileSize + appended - sizeof(Header) > 2 * live + compactSlack)
+	{
+		//Written aside with the live chuncks only then renamed over the region, a crash leaves the previous file whole
+		std::string tmpPath = path + ".tmp";
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (file)
+		{
+			size_t offset = sizeof(Header);
+			file.seekp(offset);
+			for (int i = 0; i < regionSize * regionSize; ++i)
+			{
+				Entry & entry = header->entries[i];
+				if (written[i] || entry.size == 0 || (size_t)entry.offset + entry.size > fileSize)
+				{
+					entry.size = 0;
+					continue;
+				}
+				file.write((const char *)region->file.Data() + entry.offset, entry.size);
+				entry.offset = (uint32_t)offset;
+				offset += entry.size;
+			}
+			for (const std::pair<int, const std::vector<uint8_t> *> & chunck : chuncks)
+			{
+				file.write((const char *)chunck.second->data(), chunck.second->size());
+				header->entries[chunck.first] = { (uint32_t)offset, (uint32_t)chunck.second->size() };
+				offset += chunck.second->size();
+			}
+			file.seekp(0);
+			file.write((const char *)header, sizeof(Header));
+			file.close();
+
+			//The file cannot be replaced while it is mapped
+			region->file.Close();
+			region->valid = false;
+			std::remove(path.c_str());
+			if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+				std::cerr << "ERROR: RegionStore::WriteRegion could not rename " << tmpPath << std::endl;
+		}
+		else
+			std::cerr << "ERROR: RegionStore::WriteRegion could not open " << tmpPath << std::endl;
+	}
+	else
+	{
+		//The file cannot be written while it is mapped
+		region->file.Close();
+		region->valid = false;
+
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		if (file)
+		{
+			//Never written over a previous copy: the chuncks are appended before their entries point to them, a crash in between keeps the previous copies
+			file.seekp(fileSize);
+			for (const std::pair<int, const std::vector<uint8_t> *> & chunck : chuncks)
+			{
+				file.write((const char *)chunck.second->data(), chunck.second->size());
+				header->entries[chunck.first] = { (uint32_t)fileSize, (uint32_t)chunck.second->size() };
+				fileSize += chunck.second->size();
+			}
+			file.flush();
+
+			for (const std::pair<int, const std::vector<uint8_t> *> & chunck : chuncks)
+			{
+				file.seekp(offsetof(Header, entries) + chunck.first * sizeof(Entry));
+				file.write((const char *)&header->entries[chunck.first], sizeof(Entry));
+			}
+			file.close();
+		}
+		else
+			std::cerr << "ERROR: RegionStore::WriteRegion could not open " << path << std::endl;
+	}
+	delete header;
+
+	region->valid = region->file.Open(path) && region->file.Size() >= sizeof(Header) && ValidHeader(*(const Header *)region->file.Data());
+	if (!region->valid)
+		region->file.Close();
+}
+
+float RegionStore::LoadTime() const { return m_loadTime; }
+
+int RegionStore::PendingWrites()
+{
+	std::lock_guard<std::mutex> lock(m_writesMtx);
+	return (int)(m_pendingWrites.size() + m_currentWrites.size());
+}
+
+RegionStore::~RegionStore()
+{
+	m_writesMtx.lock();
+	m_quitting = true;
+	m_writesCondition.notify_all();
+	m_writesMtx.unlock();
+
+	m_writeThread->join();
+	delete m_writeThread;
+
+	for (std::pair<const uint64_t, Region *> & region : m_regions)
+		delete region.second;
+}
@@ -1,17 +1,86 @@
 #include "engine/map/SubChunck.h"
+#include "engine/map/ChunckPool.h"
 
-SubChunck::SubChunck(glm::ivec3 position, Chunck * parent) :
-	m_position(position),
+#include <cstring>
+#include <bitset>
+
+namespace
+{
+	//Spreads the 4 bits of a coordinate two bits apart, interleaving x, y and z gives the morton index
+	struct MortonTable
+	{
+		constexpr MortonTable() : bits()
+		{
+			for (int i = 0; i < SubChunck::size; ++i)
+				bits[i] = (i & 1) | ((i & 2) << 2) | ((i & 4) << 4) | ((i & 8) << 6);
+		}
+		int bits[SubChunck::size];
+	};
+	constexpr MortonTable morton;
+	static_assert(SubChunck::size == 16, "The morton table interleaves 4 bits coordinates");
+}
+
+std::atomic<uint32_t> SubChunck::m_connectivityVersion(0);
+bool SubChunck::m_mortonLayout = true;
+
+SubChunck::SubChunck(Chunck * parent, ChunckPool * pool) :
 	m_parent(parent),
-	m_modelOpaque(nullptr),
-	m_modelTransparent(nullptr),
-	m_shape(nullptr),
+	m_colliderGenerated(false),
+	m_position(0, 0, 0),
+	m_pool(pool),
+	m_blocks(nullptr),
+	m_connectivity(allConnected),
+	m_solidLayers(0),
 	m_rb(nullptr),
-	m_isEmpty(true),
-	m_colliderGenerated(false)
+	m_shape(nullptr)
 {
-	m_btMesh.preallocateVertices(SubChunck::size*SubChunck::size*SubChunck::size);
-	m_btMesh.preallocateIndices(SubChunck::size*SubChunck::size*SubChunck::size);
+	m_uniform.SetType(Block::Type::air);
+	std::memset(m_typeCounts, 0, sizeof(m_typeCounts));
+	m_typeCounts[Block::Type::air] = SubChunck::volume;
+}
+
+void SubChunck::Reset(glm::ivec3 position)
+{
+	m_position = position;
+	m_uniform.SetType(Block::Type::air);
+	std::memset(m_typeCounts, 0, sizeof(m_typeCounts));
+	m_typeCounts[Block::Type::air] = SubChunck::volume;
+	m_typeRows.clear();
+	m_connectivity = allConnected;
+	m_solidLayers = 0;
+	++m_connectivityVersion;
+	m_colliderGenerated = false;
+	m_regenerateColliderNextUpdate = false;
+	m_enabled = true;
+	STATS_enabled = true;
+	STATS_triangles = 0;
+}
+
+void SubChunck::Unload()
+{
+	if (m_meshOpaque.count > 0)
+		World::MeshChanged(m_position);
+	m_pool->Arena().Free(m_meshOpaque);
+	m_pool->Arena().Free(m_meshTransparent);
+	m_pool->Arena().Discard(m_stagedOpaque);
+	m_pool->Arena().Discard(m_stagedTransparent);
+	m_pool->Culler().Remove(m_cullSlot);
+
+	if (m_rb) Physics::DeleteRigidBody(m_rb);
+	if (m_shape) delete(m_shape);
+	m_rb = nullptr;
+	m_shape = nullptr;
+
+	m_verticesOpaque.clear();
+	m_verticesTransparent.clear();
+	STATS_triangles = 0;
+
+	if (m_blocks)
+	{
+		m_pool->ReleaseBlocks(m_blocks);
+		m_blocks = nullptr;
+	}
+	std::vector<uint16_t>().swap(m_typeRows);
 }
 
 void SubChunck::Update(float delta)
@@ -23,100 +92,322 @@ void SubChunck::Update(float delta)
 	}
 }
 
-Block* SubChunck::GetBlock(glm::ivec3 position)
+const Block* SubChunck::GetBlockOrNeighbour(glm::ivec3 position) const
 {
-	return &m_blocks[position.x][position.y][position.z];
+	//Walks to the neighbour holding the block without the world lookup, position is at most one subChunck outside
+	const SubChunck * subChunck = this;
+	if (position.x < 0) { subChunck = subChunck->m_neighbours[left]; position.x += SubChunck::size; }
+	else if (position.x >= SubChunck::size) { subChunck = subChunck->m_neighbours[right]; position.x -= SubChunck::size; }
+	if (!subChunck)
+		return nullptr;
+
+	if (position.y < 0) { subChunck = subChunck->m_neighbours[bottom]; position.y += SubChunck::size; }
+	else if (position.y >= SubChunck::size) { subChunck = subChunck->m_neighbours[top]; position.y -= SubChunck::size; }
+	if (!subChunck)
+		return nullptr;
+
+	if (position.z < 0) { subChunck = subChunck->m_neighbours[back]; position.z += SubChunck::size; }
+	else if (position.z >= SubChunck::size) { subChunck = subChunck->m_neighbours[front]; position.z -= SubChunck::size; }
+	if (!subChunck)
+		return nullptr;
+
+	return subChunck->GetBlock(position);
 }
 
-glm::ivec3 SubChunck::Position() const
+SubChunck * SubChunck::Neighbour(Face face) const
 {
-	return m_position;
+	return m_neighbours[face];
 }
 
-void SubChunck::CheckEmpty()
+bool SubChunck::PendingUpdate() const
 {
+	return m_regenerateColliderNextUpdate;
+}
+
+bool SubChunck::MortonLayout() { return m_mortonLayout; }
+void SubChunck::SetMortonLayout(bool state) { m_mortonLayout = state; }
+
+int SubChunck::Index(int x, int y, int z)
+{
+	if (m_mortonLayout)
+		return (morton.bits[x] << 2) | (morton.bits[y] << 1) | morton.bits[z];
+	else
+		return (x * SubChunck::size + y) * SubChunck::size + z;
+}
+
+const Block* SubChunck::GetBlock(glm::ivec3 position) const
+{
+	//Acquire pairs with the release of Materialize, the mesh thread sees a filled array
+	const Block * blocks = m_blocks.load(std::memory_order_acquire);
+	if (blocks)
+		return &blocks[Index(position.x, position.y, position.z)];
+	else
+		return &m_uniform;
+}
+
+void SubChunck::SetBlock(glm::ivec3 position, Block::Type type)
+{
+	if (!m_blocks)
+	{
+		if (type == m_uniform.type)
+			return;
+		Materialize();
+	}
+	Block & block = m_blocks.load()[Index(position.x, position.y, position.z)];
+	--m_typeCounts[block.type];
+	++m_typeCounts[type];
+	if (!m_typeRows.empty())
+	{
+		int row = position.x * SubChunck::size + position.y;
+		m_typeRows[block.type * SubChunck::size * SubChunck::size + row] &= ~(1 << position.z);
+		m_typeRows[type * SubChunck::size * SubChunck::size + row] |= 1 << position.z;
+	}
+	block.SetType(type);
+}
+
+int SubChunck::Count(Block::Type type) const
+{
+	return m_typeCounts[type];
+}
+
+void SubChunck::BuildTypeRows()
+{
+	m_typeRows.assign(Block::Type::count * SubChunck::size * SubChunck::size, 0);
 	for (int x = 0; x < SubChunck::size; ++x)
 		for (int y = 0; y < SubChunck::size; ++y)
 			for (int z = 0; z < SubChunck::size; ++z)
-			{
-				Block* block = GetBlock({ x, y, z });
-				if (block->type != Block::Type::air)
+				m_typeRows[GetBlock({ x, y, z })->type * SubChunck::size * SubChunck::size + x * SubChunck::size + y] |= 1 << z;
+}
+
+void SubChunck::FindBlocks(Block::Type type, glm::ivec3 min, glm::ivec3 max, std::vector<glm::ivec3> & found)
+{
+	min = glm::max(min, glm::ivec3(0));
+	max = glm::min(max, glm::ivec3(SubChunck::size - 1));
+	if (m_typeCounts[type] == 0 || glm::any(glm::greaterThan(min, max)))
+		return;
+
+	//Uniform subChuncks have no rows, every block has the type
+	if (!m_blocks)
+	{
+		for (int x = min.x; x <= max.x; ++x)
+			for (int y = min.y; y <= max.y; ++y)
+				for (int z = min.z; z <= max.z; ++z)
+					found.push_back(glm::ivec3(x, y, z));
+		return;
+	}
+
+	if (m_typeRows.empty())
+		BuildTypeRows();
+
+	//One row covers every z of a (x, y), the z outside of the box are masked out
+	const uint16_t zMask = (uint16_t)(((1 << (max.z + 1)) - 1) & ~((1 << min.z) - 1));
+	const uint16_t * rows = &m_typeRows[type * SubChunck::size * SubChunck::size];
+	for (int x = min.x; x <= max.x; ++x)
+		for (int y = min.y; y <= max.y; ++y)
+		{
+			uint16_t row = rows[x * SubChunck::size + y] & zMask;
+			for (int z = min.z; row != 0; ++z)
+				if (row & (1 << z))
 				{
-					m_isEmpty = false;
-					return;
+					found.push_back(glm::ivec3(x, y, z));
+					row &= ~(1 << z);
 				}
-			}
-	m_isEmpty = true;
+		}
+}
+
+void SubChunck::Materialize()
+{
+	//The array is filled before being published, the mesh thread may be reading the uniform block
+	Block * blocks = m_pool->AcquireBlocks();
+	for (int i = 0; i < SubChunck::volume; ++i)
+		blocks[i] = m_uniform;
+	m_blocks.store(blocks, std::memory_order_release);
+}
+
+void SubChunck::Compact()
+{
+	if (!m_blocks)
+		return;
+
+	//The histogram tells if a single type is left
+	Block * blocks = m_blocks;
+	if (m_typeCounts[blocks[0].type] != SubChunck::volume)
+		return;
+
+	m_uniform = blocks[0];
+	m_blocks = nullptr;
+	m_pool->ReleaseBlocks(blocks);
+}
+
+void SubChunck::Compress(std::vector<uint8_t> & data) const
+{
+	//Runs of (type, 16 bits length) in storage order, a uniform subChunck is a single run
+	const Block * stored = m_blocks;
+	const Block * blocks = stored ? stored : &m_uniform;
+	const int count = stored ? SubChunck::volume : 1;
+
+	int start = 0;
+	for (int i = 1; i <= count; ++i)
+		if (i == count || blocks[i].type != blocks[start].type)
+		{
+			int length = stored ? i - start : SubChunck::volume;
+			data.push_back((uint8_t)blocks[start].type);
+			data.push_back((uint8_t)(length & 0xff));
+			data.push_back((uint8_t)(length >> 8));
+			start = i;
+		}
+}
+
+const uint8_t * SubChunck::Decompress(const uint8_t * data, const uint8_t * end)
+{
+	if (end - data < 3 || data[0] >= Block::Type::invalid)
+		return nullptr;
+
+	if ((data[1] | (data[2] << 8)) == SubChunck::volume)
+	{
+		if (m_blocks)
+		{
+			m_pool->ReleaseBlocks(m_blocks);
+			m_blocks = nullptr;
+		}
+		m_uniform.SetType((Block::Type)data[0]);
+		std::memset(m_typeCounts, 0, sizeof(m_typeCounts));
+		m_typeCounts[data[0]] = SubChunck::volume;
+		m_typeRows.clear();
+		return data + 3;
+	}
+
+	Block * blocks = m_blocks ? m_blocks.load() : m_pool->AcquireBlocks();
+	std::memset(m_typeCounts, 0, sizeof(m_typeCounts));
+	m_typeRows.clear();
+
+	int index = 0;
+	while (index < SubChunck::volume)
+	{
+		int length = end - data < 3 || data[0] >= Block::Type::invalid ? 0 : data[1] | (data[2] << 8);
+		if (length == 0 || index + length > SubChunck::volume)
+		{
+			//Left all air, the blocks and the histogram stay consistent for the generation replacing the chunck
+			m_pool->ReleaseBlocks(blocks);
+			m_blocks = nullptr;
+			m_uniform.SetType(Block::Type::air);
+			std::memset(m_typeCounts, 0, sizeof(m_typeCounts));
+			m_typeCounts[Block::Type::air] = SubChunck::volume;
+			return nullptr;
+		}
+
+		Block block;
+		block.SetType((Block::Type)data[0]);
+		for (int i = 0; i < length; ++i)
+			blocks[index++] = block;
+		m_typeCounts[data[0]] += length;
+		data += 3;
+	}
+	m_blocks.store(blocks, std::memory_order_release);
+	return data;
+}
+
+bool SubChunck::Uniform() const
+{
+	return m_blocks == nullptr;
+}
+
+Block::Type SubChunck::UniformType() const
+{
+	return m_uniform.type;
+}
+
+bool SubChunck::Buried() const
+{
+	//Uniform opaque subChunck surrounded by uniform opaque subChuncks, none of its faces can be seen
+	if (m_blocks || !m_uniform.solid || m_uniform.seeThrough)
+		return false;
+	for (int face = 0; face < 6; ++face)
+	{
+		const SubChunck * neighbour = m_neighbours[face];
+		if (!neighbour || neighbour->m_blocks || !neighbour->m_uniform.solid || neighbour->m_uniform.seeThrough)
+			return false;
+	}
+	return true;
+}
+
+glm::ivec3 SubChunck::Position() const
+{
+	return m_position;
 }
 
 void SubChunck::SetEnabled(bool state)
 {
 	m_enabled = state;
 	STATS_enabled = m_enabled;
+	UpdateCullRecord();
 }
 
+bool SubChunck::Enabled() const { return m_enabled; }
+bool SubChunck::HasMesh() const { return m_meshOpaque.count > 0 || m_meshTransparent.count > 0; }
+
 void SubChunck::GenerateCollider(bool now)
 {
 	if (!now)
 	{
 		m_regenerateColliderNextUpdate = true;  
+		World::ScheduleUpdate(this);
 		return;
 	}
 	m_colliderGenerated = true;
 
-	std::vector<btVector3> btVertices;
-	btVertices.reserve(SubChunck::size*SubChunck::size*SubChunck::size);
+	//Air and buried subChuncks have no face to collide with
+	if (!HasFaces())
+	{
+		if (m_rb) Physics::DeleteRigidBody(m_rb);
+		m_rb = nullptr;
+		return;
+	}
 
 	std::vector<Mesh::Vertex> vertices;
 	for (int x = 0; x < SubChunck::size; ++x)
 		for (int y = 0; y < SubChunck::size; ++y)
 			for (int z = 0; z < SubChunck::size; ++z)
 			{
-				Block* block = GetBlock({ x, y, z });
+				const Block* block = GetBlock({ x, y, z });
 				if (block->solid)
 				{
-					glm::ivec3 pos = m_position * SubChunck::size + glm::ivec3(x, y + 1, z);
-					Block* otherBlock = World::GetBlock(pos);
+					const Block* otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y + 1, z));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> topFace = Cube::cubeTopFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Top(block->type));
 						vertices.insert(vertices.end(), topFace.begin(), topFace.end());
 					}
 
-					pos = m_position * SubChunck::size + glm::ivec3(x, y - 1, z);
-					otherBlock = World::GetBlock(pos);
+					otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y - 1, z));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> botFace = Cube::cubeBotFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Bot(block->type));
 						vertices.insert(vertices.end(), botFace.begin(), botFace.end());
 					}
 
-					pos = m_position * SubChunck::size + glm::ivec3(x - 1, y, z);
-					otherBlock = World::GetBlock(pos);
+					otherBlock = GetBlockOrNeighbour(glm::ivec3(x - 1, y, z));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> leftFace = Cube::cubeLeftFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Left(block->type));
 						vertices.insert(vertices.end(), leftFace.begin(), leftFace.end());
 					}
 
-					pos = m_position * SubChunck::size + glm::ivec3(x + 1, y, z);
-					otherBlock = World::GetBlock(pos);
+					otherBlock = GetBlockOrNeighbour(glm::ivec3(x + 1, y, z));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> rightFace = Cube::cubeRightFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Right(block->type));
 						vertices.insert(vertices.end(), rightFace.begin(), rightFace.end());
 					}
 
-					pos = m_position * SubChunck::size + glm::ivec3(x, y, z - 1);
-					otherBlock = World::GetBlock(pos);
+					otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y, z - 1));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> backFace = Cube::cubeBackFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Back(block->type));
 						vertices.insert(vertices.end(), backFace.begin(), backFace.end());
 					}
 
-					pos = m_position * SubChunck::size + glm::ivec3(x, y, z + 1);
-					otherBlock = World::GetBlock(pos);
+					otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y, z + 1));
 					if (!otherBlock || !otherBlock->solid)
 					{
 						std::vector<Mesh::Vertex> frontFace = Cube::cubeFrontFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Front(block->type));
@@ -126,29 +417,168 @@ void SubChunck::GenerateCollider(bool now)
 			}
 
 	if (m_rb) Physics::DeleteRigidBody(m_rb);
+	m_rb = nullptr;
+	if (m_shape) delete(m_shape);
+	m_shape = nullptr;
 
-	//Get vertices
-	for (Mesh::Vertex vertex : vertices)
-		btVertices.push_back(btVector3((float)m_position.x, (float)m_position.y, (float)m_position.z)*(float)SubChunck::size*Block::size + btVector3(vertex.vertex.x, vertex.vertex.y, vertex.vertex.z));
-
-	if (btVertices.size() >= 3)
+	//Get vertices, the arrays of the previous collider are refilled
+	m_colliderVertices.resize(0);
+	m_colliderIndices.resize(0);
+	const btVector3 offset = btVector3((float)m_position.x, (float)m_position.y, (float)m_position.z)*(float)SubChunck::size*Block::size;
+	for (const Mesh::Vertex & vertex : vertices)
 	{
-		m_btMesh = btTriangleMesh();
-		for (int i = 0; i < (int)btVertices.size() / 3; ++i)
-			m_btMesh.addTriangle((btVertices)[3 * i + 0], (btVertices)[3 * i + 1], (btVertices)[3 * i + 2]);
+		m_colliderIndices.push_back(m_colliderVertices.size());
+		m_colliderVertices.push_back(offset + btVector3(vertex.vertex.x, vertex.vertex.y, vertex.vertex.z));
+	}
 
-		if (m_shape) delete(m_shape);
-		m_shape = new btBvhTriangleMeshShape(&m_btMesh, false);
+	if (m_colliderVertices.size() >= 3)
+	{
+		if (!m_btMesh)
+		{
+			m_btMesh = new btTriangleIndexVertexArray();
+			m_btMesh->addIndexedMesh(btIndexedMesh());
+			m_colliderVertices.reserve(SubChunck::volume);
+			m_colliderIndices.reserve(SubChunck::volume);
+		}
+
+		//The arrays may have moved while growing
+		btIndexedMesh & mesh = m_btMesh->getIndexedMeshArray()[0];
+		mesh.m_numTriangles = m_colliderIndices.size() / 3;
+		mesh.m_triangleIndexBase = (const unsigned char *)&m_colliderIndices[0];
+		mesh.m_triangleIndexStride = 3 * sizeof(int);
+		mesh.m_numVertices = m_colliderVertices.size();
+		mesh.m_vertexBase = (const unsigned char *)&m_colliderVertices[0];
+		mesh.m_vertexStride = sizeof(btVector3);
+
+		m_shape = new btBvhTriangleMeshShape(m_btMesh, false);
 		btTransform transform = btTransform::getIdentity();
 		m_rb = Physics::CreateRigidBody(0, transform, m_shape);
 		m_rb->SetTag(Tag::chunck);
 	}
 }
 
+bool SubChunck::HasFaces() const
+{
+	//Air and buried subChuncks have no visible face
+	return !Uniform() || (m_uniform.solid && !Buried());
+}
+
+uint64_t SubChunck::ContentHash() const
+{
+	//FNV-1a, the blocks bordering the subChunck decide which faces are visible
+	uint64_t hash = 14695981039346656037ull;
+	for (int x = 0; x < SubChunck::size; ++x)
+		for (int y = 0; y < SubChunck::size; ++y)
+			for (int z = 0; z < SubChunck::size; ++z)
+				hash = (hash ^ (uint8_t)GetBlock({ x, y, z })->type) * 1099511628211ull;
+
+	for (int i = 0; i < SubChunck::size; ++i)
+		for (int j = 0; j < SubChunck::size; ++j)
+		{
+			const glm::ivec3 border[6] = { { SubChunck::size, i, j }, { -1, i, j }, { i, SubChunck::size, j }, { i, -1, j }, { i, j, SubChunck::size }, { i, j, -1 } };
+			for (const glm::ivec3 & position : border)
+			{
+				const Block * block = GetBlockOrNeighbour(position);
+				hash = (hash ^ (block ? (uint8_t)block->type : 0xFF)) * 1099511628211ull;
+			}
+		}
+	return hash;
+}
+
+void SubChunck::ComputeConnectivity()
+{
+	uint64_t connectivity = 0;
+	if (Uniform())
+	{
+		connectivity = !m_uniform.solid || m_uniform.seeThrough ? allConnected : 0;
+		m_solidLayers = connectivity ? 0 : SubChunck::size;
+	}
+	else
+	{
+		//Cells indexed x + size * (y + size * z)
+		std::bitset<SubChunck::volume> open;
+		for (int z = 0; z < SubChunck::size; ++z)
+			for (int y = 0; y < SubChunck::size; ++y)
+				for (int x = 0; x < SubChunck::size; ++x)
+				{
+					const Block * block = GetBlock({ x, y, z });
+					open[x + SubChunck::size * (y + SubChunck::size * z)] = !block->solid || block->seeThrough;
+				}
+
+		//Layers without any open cell from the bottom
+		int solidLayers = 0;
+		while (solidLayers < SubChunck::size)
+		{
+			bool solid = true;
+			for (int z = 0; z < SubChunck::size && solid; ++z)
+				for (int x = 0; x < SubChunck::size && solid; ++x)
+					solid = !open[x + SubChunck::size * (solidLayers + SubChunck::size * z)];
+			if (!solid)
+				break;
+			++solidLayers;
+		}
+		m_solidLayers = solidLayers;
+
+		//Flood fill of every open region, the faces it touches are linked together
+		uint16_t stack[SubChunck::volume];
+		for (int first = 0; first < SubChunck::volume; ++first)
+		{
+			if (!open[first])
+				continue;
+
+			int faces = 0;
+			int count = 0;
+			stack[count++] = (uint16_t)first;
+			open[first] = false;
+			while (count > 0)
+			{
+				int cell = stack[--count];
+				int x = cell % SubChunck::size;
+				int y = (cell / SubChunck::size) % SubChunck::size;
+				int z = cell / (SubChunck::size * SubChunck::size);
+
+				if (x == SubChunck::size - 1) faces |= 1 << right;
+				if (x == 0) faces |= 1 << left;
+				if (y == SubChunck::size - 1) faces |= 1 << top;
+				if (y == 0) faces |= 1 << bottom;
+				if (z == SubChunck::size - 1) faces |= 1 << front;
+				if (z == 0) faces |= 1 << back;
+
+				const int steps[6] = { 1, -1, SubChunck::size, -SubChunck::size, SubChunck::size * SubChunck::size, -SubChunck::size * SubChunck::size };
+				const bool inside[6] = { x < SubChunck::size - 1, x > 0, y < SubChunck::size - 1, y > 0, z < SubChunck::size - 1, z > 0 };
+				for (int face = 0; face < 6; ++face)
+				{
+					int next = cell + steps[face];
+					if (inside[face] && open[next])
+					{
+						open[next] = false;
+						stack[count++] = (uint16_t)next;
+					}
+				}
+			}
+
+			for (int from = 0; from < 6; ++from)
+				if (faces & (1 << from))
+					connectivity |= (uint64_t)faces << (6 * from);
+		}
+	}
+
+	if (m_connectivity.exchange(connectivity) != connectivity)
+		++m_connectivityVersion;
+}
+
+bool SubChunck::Connected(int from, int to) const
+{
+	return (m_connectivity.load(std::memory_order_relaxed) >> (6 * from + to)) & 1;
+}
+
+uint32_t SubChunck::ConnectivityVersion() { return m_connectivityVersion; }
+int SubChunck::SolidLayers() const { return m_solidLayers; }
+int SubChunck::TriangleCount() const { return (int)(m_meshOpaque.count + m_meshTransparent.count) / 3; }
+
 void SubChunck::GenerateMesh()
 {
-	CheckEmpty();
-	if (!m_isEmpty)
+	if (HasFaces())
 	{
 		std::vector<Mesh::Vertex>* targetVertices = nullptr;
 
@@ -156,7 +586,7 @@ void SubChunck::GenerateMesh()
 			for (int y = 0; y < SubChunck::size; ++y)
 				for (int z = 0; z < SubChunck::size; ++z)
 				{
-					Block* block = GetBlock({ x, y, z });
+					const Block* block = GetBlock({ x, y, z });
 
 					//Set target
 					if (block->transparent)
@@ -174,48 +604,42 @@ void SubChunck::GenerateMesh()
 						}
 						else//Regular block
 						{
-							glm::ivec3 pos = m_position * SubChunck::size + glm::ivec3(x, y + 1, z);
-							Block * otherBlock = World::GetBlock(pos);
+							const Block * otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y + 1, z));
 							if (!otherBlock || (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> topFace = Cube::cubeTopFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Top(block->type));
 								targetVertices->insert(targetVertices->end(), topFace.begin(), topFace.end());
 							}
 
-							pos = m_position * SubChunck::size + glm::ivec3(x, y - 1, z);
-							otherBlock = World::GetBlock(pos);
+							otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y - 1, z));
 							if (otherBlock && (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> botFace = Cube::cubeBotFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Bot(block->type));
 								targetVertices->insert(targetVertices->end(), botFace.begin(), botFace.end());
 							}
 
-							pos = m_position * SubChunck::size + glm::ivec3(x - 1, y, z);
-							otherBlock = World::GetBlock(pos);
+							otherBlock = GetBlockOrNeighbour(glm::ivec3(x - 1, y, z));
 							if (otherBlock && (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> leftFace = Cube::cubeLeftFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Left(block->type));
 								targetVertices->insert(targetVertices->end(), leftFace.begin(), leftFace.end());
 							}
 
-							pos = m_position * SubChunck::size + glm::ivec3(x + 1, y, z);
-							otherBlock = World::GetBlock(pos);
+							otherBlock = GetBlockOrNeighbour(glm::ivec3(x + 1, y, z));
 							if (otherBlock && (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> rightFace = Cube::cubeRightFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Right(block->type));
 								targetVertices->insert(targetVertices->end(), rightFace.begin(), rightFace.end());
 							}
 
-							pos = m_position * SubChunck::size + glm::ivec3(x, y, z - 1);
-							otherBlock = World::GetBlock(pos);
+							otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y, z - 1));
 							if (otherBlock && (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> backFace = Cube::cubeBackFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Back(block->type));
 								targetVertices->insert(targetVertices->end(), backFace.begin(), backFace.end());
 							}
 
-							pos = m_position * SubChunck::size + glm::ivec3(x, y, z + 1);
-							otherBlock = World::GetBlock(pos);
+							otherBlock = GetBlockOrNeighbour(glm::ivec3(x, y, z + 1));
 							if (otherBlock && (!otherBlock->solid || (otherBlock->seeThrough && (otherBlock->type != block->type || (!otherBlock->transparent || !block->transparent)))))
 							{
 								std::vector<Mesh::Vertex> frontFace = Cube::cubeFrontFace(Block::size, (float)x, (float)y, (float)z, TexturesBlocks::Front(block->type));
@@ -228,45 +652,90 @@ void SubChunck::GenerateMesh()
 	}
 }
 
+void SubChunck::StageMesh()
+{
+	//On failure (ring full or not mapped) the vertices stay in the vectors and are uploaded from there
+	m_stagedOpaque = m_pool->Arena().Stage(m_verticesOpaque);
+	if (m_stagedOpaque.size > 0)
+	{
+		m_verticesOpaque.clear();
+		m_verticesOpaque.shrink_to_fit();
+	}
+
+	m_stagedTransparent = m_pool->Arena().Stage(m_verticesTransparent);
+	if (m_stagedTransparent.size > 0)
+	{
+		m_verticesTransparent.clear();
+		m_verticesTransparent.shrink_to_fit();
+	}
+}
+
+size_t SubChunck::MeshBytes() const
+{
+	return m_stagedOpaque.size + m_stagedTransparent.size + (m_verticesOpaque.size() + m_verticesTransparent.size()) * sizeof(Mesh::Vertex);
+}
+
 void SubChunck::GenerateModels()
 {
 	STATS_triangles = 0;
 
-	//Generates opaque
-	if (m_modelOpaque) delete(m_modelOpaque);
-	m_modelOpaque = new Model(m_verticesOpaque);
-	m_modelOpaque->Translate(SubChunck::size * Block::size * glm::vec3(m_position.x, m_position.y, m_position.z));
-	STATS_triangles += m_verticesOpaque.size() / 3;
+	//Only the opaque meshes cast shadows
+	if (m_meshOpaque.count > 0 || m_stagedOpaque.size > 0 || !m_verticesOpaque.empty())
+		World::MeshChanged(m_position);
+
+	//Generates opaque, nothing is allocated for subChuncks without faces
+	m_pool->Arena().Free(m_meshOpaque);
+	STATS_triangles += (m_stagedOpaque.size / sizeof(Mesh::Vertex) + m_verticesOpaque.size()) / 3;
+	if (m_stagedOpaque.size > 0)
+		m_meshOpaque = m_pool->Arena().Allocate(m_stagedOpaque);
+	else
+		m_meshOpaque = m_pool->Arena().Allocate(m_verticesOpaque);
 	m_verticesOpaque.clear();
 	m_verticesOpaque.shrink_to_fit();
 
 	//Generates transparent
-	if (m_modelTransparent) delete(m_modelTransparent);
-	m_modelTransparent = new Model(m_verticesTransparent);
-	m_modelTransparent->Translate(SubChunck::size * Block::size * glm::vec3(m_position.x, m_position.y, m_position.z));
-	STATS_triangles += m_verticesTransparent.size() / 3;
+	m_pool->Arena().Free(m_meshTransparent);
+	STATS_triangles += (m_stagedTransparent.size / sizeof(Mesh::Vertex) + m_verticesTransparent.size()) / 3;
+	if (m_stagedTransparent.size > 0)
+		m_meshTransparent = m_pool->Arena().Allocate(m_stagedTransparent);
+	else
+		m_meshTransparent = m_pool->Arena().Allocate(m_verticesTransparent);
 	m_verticesTransparent.clear();
 	m_verticesTransparent.shrink_to_fit();
 
+	UpdateCullRecord();
 }
 
+void SubChunck::UpdateCullRecord()
+{
+	//The GPU culling draws every record, the subChuncks the CPU path would skip have none
+	if (HasMesh() && m_enabled && m_parent->Resident() && m_parent->Enabled())
+		m_pool->Culler().Set(m_cullSlot, { glm::vec4(SubChunck::size * Block::size * glm::vec3(m_position), 0.f), m_meshOpaque.first, m_meshOpaque.count, m_meshTransparent.first, m_meshTransparent.count });
+	else
+		m_pool->Culler().Remove(m_cullSlot);
+}
+
+void SubChunck::DrawTransparent(std::vector<MeshArena::DrawCall> & draws) const
+{
+	if (m_meshTransparent.count > 0 && m_enabled)
+		draws.push_back({ m_meshTransparent, SubChunck::size * Block::size * glm::vec3(m_position) });
+}
 
-void SubChunck::DrawTransparent(const Shader & shader) const
+void SubChunck::DrawOpaque(std::vector<MeshArena::DrawCall> & draws) const
 {
-	if(m_modelTransparent && m_enabled)
-		m_modelTransparent->Draw(shader);
+	if (m_meshOpaque.count > 0 && m_enabled)
+		draws.push_back({ m_meshOpaque, SubChunck::size * Block::size * glm::vec3(m_position) });
 }
 
-void SubChunck::DrawOpaque(const Shader & shader) const
+void SubChunck::DrawCaster(std::vector<MeshArena::DrawCall> & draws) const
 {
-	if(m_modelOpaque && m_enabled)
-		m_modelOpaque->Draw(shader);
+	if (m_meshOpaque.count > 0)
+		draws.push_back({ m_meshOpaque, SubChunck::size * Block::size * glm::vec3(m_position) });
 }
 
 SubChunck::~SubChunck()
 {
-	if (m_modelOpaque) delete(m_modelOpaque);
-	if (m_modelTransparent) delete(m_modelTransparent);
 	if (m_rb) Physics::DeleteRigidBody(m_rb);
 	if (m_shape) delete(m_shape);
+	if (m_btMesh) delete(m_btMesh);
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "engine/map/ViewDistanceController.h"
+
+ViewDistanceController::ViewDistanceController() :
+	m_enabled(false),
+	m_averageFrameTime(0.f),
+	m_lastChange(0.f)
+{
+}
+
+void ViewDistanceController::Update(float frameTime)
+{
+	//Smoothed to ignore spikes
+	m_averageFrameTime = glm::mix(m_averageFrameTime, frameTime, 0.05f);
+
+	if (!m_enabled || Time::ElapsedSinceStartup() - m_lastChange < cooldown)
+		return;
+
+	int backlog = World::GeneratorBacklog();
+	int size = World::Size();
+
+	//Shrinks when frames are too long or when the generators cannot keep up, grows only when both are comfortable
+	if ((m_averageFrameTime > 1.15f * targetFrameTime || backlog > maxBacklog) && size > World::minSize)
+		World::SetSize(size - step);
+	else if (m_averageFrameTime < 0.8f * targetFrameTime && backlog == 0 && size < World::maxSize)
+		World::SetSize(size + step);
+	else
+		return;
+
+	m_lastChange = Time::ElapsedSinceStartup();
+}
+
+void ViewDistanceController::SetEnabled(bool state) { m_enabled = state; }
+bool ViewDistanceController::Enabled() const { return m_enabled; }
+float ViewDistanceController::AverageFrameTime() const { return m_averageFrameTime; }
@@ -1,6 +1,36 @@
 #include "engine/map/World.h"
 
-CircularArray World::m_array(World::size, 100,100);
+const float World::prefetchTime = 2.f;
+
+int World::m_playerAnchor = -1;
+uint32_t World::m_tick = 0;
+const float World::cullReuseDistance = 0.5f;
+const float World::cullReuseAngle = 0.002f;
+bool World::m_cullValid = false;
+uint32_t World::m_cullVersion = 0;
+glm::vec3 World::m_cullPosition;
+glm::vec3 World::m_cullForward;
+glm::vec3 World::m_cullUp;
+glm::vec3 World::m_cullRight;
+glm::mat4 World::m_cullProjection;
+glm::ivec3 World::m_cullCell;
+uint32_t World::m_cullConnectivity = 0;
+bool World::m_occlusionCulling = true;
+uint32_t World::m_visibleMark = 0;
+uint32_t World::m_skyVersion = 0;
+uint32_t World::m_skyConnectivity = 0;
+int World::m_frustumCount = 0;
+int World::m_drawnCount = 0;
+const float World::occluderDistance = 6.f * SubChunck::size;
+bool World::m_rasterOcclusion = true;
+OcclusionBuffer World::m_occlusion;
+float World::m_rasterTime = 0.f;
+int World::m_rasterCulled = 0;
+int World::m_rasterCulledTriangles = 0;
+std::deque<World::MeshChange> World::m_meshChanges;
+uint32_t World::m_meshVersion = 0;
+bool World::m_gpuCulling = false;
+float World::m_gpuCullingTime = 0.f;
 World World::m_instance = World();
 
 World::World() 
@@ -8,195 +38,589 @@ World::World()
 
 } 
 
+ChunckStreamer & World::Streamer()
+{
+	//Built on first use, a program that never loads the world (the pregeneration) starts no generator thread nor journal
+	static ChunckStreamer streamer(World::defaultSize);
+	return streamer;
+}
+
 Chunck* World::GetChunck(int x, int z)
 { 
-	return m_array.Get(x, z);
+	return Streamer().Get(x, z);
 }
 
 
-Block* World::GetBlock(glm::ivec3 position) 
+const Block* World::GetBlock(glm::ivec3 position) 
 {
 	if (position.y < 0 || position.y >= SubChunck::size * Chunck::height)
 		return nullptr;
 
-	glm::ivec3 pos = position / SubChunck::size;
-	Chunck * chunck = GetChunck(pos.x, pos.z);
+	Chunck * chunck = GetChunck(FloorDiv(position.x, SubChunck::size), FloorDiv(position.z, SubChunck::size));
 	if (chunck)
-		return chunck->GetBlock( glm::vec3( position.x % SubChunck::size, position.y, position.z % SubChunck::size) );
+		return chunck->GetBlock( glm::ivec3( FloorMod(position.x, SubChunck::size), position.y, FloorMod(position.z, SubChunck::size)) );
 	else
 		return nullptr;
 } 
 
 
+int World::Height(int x, int z, int heightmap)
+{
+	Chunck * chunck = GetChunck(FloorDiv(x, SubChunck::size), FloorDiv(z, SubChunck::size));
+	if (chunck && chunck->BlocksGenerated())
+		return chunck->Height(FloorMod(x, SubChunck::size), FloorMod(z, SubChunck::size), (Chunck::Heightmap)heightmap);
+	else
+		return -1;
+}
+
 glm::ivec3 World::BlockAt(glm::vec3 worldPos)
 {
-	return worldPos + 0.5f * glm::vec3(Block::size, Block::size, Block::size);
+	return glm::floor(worldPos + 0.5f * glm::vec3(Block::size, Block::size, Block::size));
+}
+
+glm::ivec3 World::ChunckAt(glm::vec3 worldPos)
+{
+	return glm::floor(worldPos / (float)SubChunck::size);
 }
 
 void World::RemoveBlock(glm::ivec3 position)
 {
-		Block* block = GetBlock(position);
+		const Block* block = GetBlock(position);
 		if (block && block->solid)
 		{
-			block->SetType(Block::Type::air);
+			SetBlock(position, Block::Type::air);
 			UpdateAround(position);
 		}
 }
  
 
-void World::SetBlock(glm::ivec3 position, Block::Type blockType)
+void World::SetBlock(glm::ivec3 position, Block::Type blockType, bool playerEdit)
 {
-	Block* block = GetBlock(position);
-	if (block)
-		block->SetType(blockType);
-}
+	if (position.y < 0 || position.y >= SubChunck::size * Chunck::height)
+		return;
 
-void World::UpdateBlock(glm::ivec3 position)
-{
-	Chunck* chunck = GetChunck(position.x / SubChunck::size, position.z / SubChunck::size);
+	Chunck * chunck = GetChunck(FloorDiv(position.x, SubChunck::size), FloorDiv(position.z, SubChunck::size));
 	if (chunck)
 	{
-		SubChunck * subChunck = chunck->GetSubChunck(position.y / SubChunck::size);
-		if (subChunck)
+		glm::ivec3 local(FloorMod(position.x, SubChunck::size), position.y, FloorMod(position.z, SubChunck::size));
+
+		//Player edits are journaled to survive a crash, generated content can be generated again
+		if (playerEdit)
 		{
-			m_array.UpdateSubChunckMesh(subChunck);
-			subChunck->GenerateCollider();
+			Block::Type oldType = chunck->GetBlock(local)->type;
+			if (oldType != blockType)
+				Streamer().RecordEdit(position, oldType, blockType, m_tick);
 		}
+		chunck->SetBlock(local, blockType);
 	}
 }
 
-void World::EnableAllChuncks()
+float World::EditStorm(glm::ivec3 center, int count)
 {
-	for (int x = 0; x < size; ++x)
-		for (int z = 0; z < size; ++z)
+	//Benchmark of the player edits throughput, each block is changed then set back so the blocks are left untouched.
+	//Same path as the player edits, journaled in a scratch journal: the world one would replay them and compact
+	const std::string scratchPath = "world/editstorm.journal";
+	std::remove(scratchPath.c_str());
+	std::map<Chunck *, bool> modified;//Restored once the blocks are set back, nothing new to save
+	std::default_random_engine generator(count);
+	std::uniform_int_distribution<int> offset(-SubChunck::size, SubChunck::size);
+
+	//The mesh thread reads the subChuncks it meshes and their neighbours, the edits stay away from them.
+	//Only the main thread queues and returns meshes, the subChuncks generating do not change during the storm
+	std::map<SubChunck *, bool> editable;
+	const glm::ivec3 first = ChunckAt(glm::vec3(center - glm::ivec3(SubChunck::size)));
+	const glm::ivec3 last = ChunckAt(glm::vec3(center + glm::ivec3(SubChunck::size)));
+	for (int x = first.x; x <= last.x; ++x)
+		for (int y = std::max(first.y, 0); y <= std::min(last.y, Chunck::height - 1); ++y)
+			for (int z = first.z; z <= last.z; ++z)
 			{
-				Chunck * chunck = World::GetChunck(m_array.OriginX() + x, m_array.OriginZ() + z);
-				if (chunck)
-					chunck->SetEnabled(true);
+				Chunck * chunck = GetChunck(x, z);
+				if (!chunck)
+					continue;
+
+				bool meshing = false;
+				for (int dx = -1; dx <= 1 && !meshing; ++dx)
+					for (int dz = -1; dz <= 1 && !meshing; ++dz)
+					{
+						Chunck * neighbour = GetChunck(x + dx, z + dz);
+						for (int dy = std::max(y - 1, 0); neighbour && dy <= std::min(y + 1, Chunck::height - 1); ++dy)
+							meshing = meshing || neighbour->GetSubChunck(dy)->generating;
+					}
+				editable[chunck->GetSubChunck(y)] = !meshing;
 			}
-}
 
-void World::ClipChuncks(const Camera & camera)
-{
-	std::vector<glm::vec3> chunckPoints =
+	float time = 0.f;
+	int edits = 0;
+	std::set<SubChunck *> touched;
 	{
-		glm::vec3(0, 0, 0),
-		glm::vec3(1, 0, 0),
-		glm::vec3(1, 0, 1),
-		glm::vec3(0, 0, 1),
-		glm::vec3(0, Chunck::height, 0),
-		glm::vec3(1, Chunck::height, 0),
-		glm::vec3(1, Chunck::height, 1),
-		glm::vec3(0, Chunck::height, 1),
-	};
-
-	std::vector<Plane> planes = camera.GetFrustrumPlanes();
-	std::vector<Plane> leftRightPlanes = { planes[0], planes[1] };
+		EditJournal journal(scratchPath);
+		Streamer().SetScratchJournal(&journal);
+		float start = Time::ElapsedSinceStartup();
+		for (int i = 0; i < count; ++i)
+		{
+			glm::ivec3 position = center + glm::ivec3(offset(generator), offset(generator), offset(generator));
+			Chunck * chunck = GetChunck(FloorDiv(position.x, SubChunck::size), FloorDiv(position.z, SubChunck::size));
+			if (!chunck || position.y < 0 || position.y >= SubChunck::size * Chunck::height)
+				continue;
+			SubChunck * subChunck = chunck->GetSubChunck(position.y / SubChunck::size);
+			std::map<SubChunck *, bool>::const_iterator it = editable.find(subChunck);
+			if (it == editable.end() || !it->second)
+				continue;
+
+			modified.insert(std::make_pair(chunck, chunck->Modified()));
+			touched.insert(subChunck);
+			Block::Type oldType = GetBlock(position)->type;
+			SetBlock(position, oldType == Block::Type::air ? Block::Type::glassBlue : Block::Type::air);
+			UpdateAround(position);
+			SetBlock(position, oldType);
+			UpdateAround(position);
+			edits += 2;
+		}
+		time = Time::ElapsedSinceStartup() - start;
+		Streamer().SetScratchJournal(nullptr);
+	}
+	std::remove(scratchPath.c_str());
+
+	//SubChuncks of a single type again give their blocks back to the pool
+	for (SubChunck * subChunck : touched)
+		subChunck->Compact();
+	for (const std::pair<Chunck * const, bool> & chunck : modified)
+		chunck.first->SetModified(chunck.second);
+	return time > 0.f ? edits / time : 0.f;
+}
 
-	std::vector<Chunck*> enabledChuncks;
-	//First pass to eliminate full chuncks
-	for (int z = 0; z < size; ++z)
-		for (int x = 0; x < size; ++x)
+void World::QueryBlocks(glm::ivec3 center, float radius, const std::vector<Block::Type> & types, std::function<bool(glm::ivec3)> visit)
+{
+	//Walks the subChuncks overlapping the sphere, those without any of the types are skipped from their histogram
+	int r = (int)std::ceil(radius);
+	glm::ivec3 min = center - glm::ivec3(r);
+	glm::ivec3 max = center + glm::ivec3(r);
+	std::vector<glm::ivec3> found;
+
+	for (int cx = FloorDiv(min.x, SubChunck::size); cx <= FloorDiv(max.x, SubChunck::size); ++cx)
+		for (int cz = FloorDiv(min.z, SubChunck::size); cz <= FloorDiv(max.z, SubChunck::size); ++cz)
 		{
-			glm::ivec3 chunckPos = glm::ivec3(m_array.OriginX() + x, 0, m_array.OriginZ() + z);
-			Chunck * chunck = GetChunck(chunckPos.x, chunckPos.z);
-			if (chunck)
+			Chunck * chunck = GetChunck(cx, cz);
+			if (!chunck || !chunck->BlocksGenerated())
+				continue;
+
+			for (int cy = std::max(FloorDiv(min.y, SubChunck::size), 0); cy <= std::min(FloorDiv(max.y, SubChunck::size), Chunck::height - 1); ++cy)
 			{
-				bool enabled = false;
-				for (glm::vec3 point : chunckPoints)
+				SubChunck * subChunck = chunck->GetSubChunck(cy);
+				glm::ivec3 origin = SubChunck::size * glm::ivec3(cx, cy, cz);
+				for (Block::Type type : types)
 				{
-					//If the chunck point is on the wrong side of a view frustrum plane
-					glm::vec3 worldPoint = (float)SubChunck::size * ( glm::vec3(chunckPos) + point);
-					bool outside = false;
-					for (Plane plane : leftRightPlanes)
-					{
-						if (plane.Right(worldPoint))
-						{
-							outside = true;
-							break;
-						}
-					}
-					if (!outside)
+					found.clear();
+					subChunck->FindBlocks(type, min - origin, max - origin, found);
+					for (const glm::ivec3 & local : found)
 					{
-						enabled = true;
-						enabledChuncks.push_back(chunck);
-						break;
+						glm::ivec3 position = origin + local;
+						glm::ivec3 delta = position - center;
+						if (delta.x * delta.x + delta.y * delta.y + delta.z * delta.z <= radius * radius && !visit(position))
+							return;
 					}
 				}
-				chunck->SetEnabled(enabled);
 			}
 		}
+}
 
-	std::vector<glm::vec3> subChunckPoints =
+std::vector<glm::ivec3> World::FindBlocks(glm::ivec3 center, float radius, const std::vector<Block::Type> & types)
+{
+	std::vector<glm::ivec3> positions;
+	QueryBlocks(center, radius, types, [&positions](glm::ivec3 position) { positions.push_back(position); return true; });
+	return positions;
+}
+
+bool World::AnyBlock(glm::ivec3 center, float radius, const std::vector<Block::Type> & types)
+{
+	bool any = false;
+	QueryBlocks(center, radius, types, [&any](glm::ivec3) { any = true; return false; });
+	return any;
+}
+
+float World::FindBlocksBenchmark(glm::ivec3 center, float radius, bool indexed)
+{
+	const std::vector<Block::Type> types = { Block::Type::wood, Block::Type::glassRed, Block::Type::glassBlue };
+
+	float start = Time::ElapsedSinceStartup();
+	if (indexed)
+		FindBlocks(center, radius, types);
+	else
 	{
-		glm::vec3(0, 0, 0),
-		glm::vec3(1, 0, 0),
-		glm::vec3(1, 0, 1),
-		glm::vec3(0, 0, 1),
-		glm::vec3(0, 1, 0),
-		glm::vec3(1, 1, 0),
-		glm::vec3(1, 1, 1),
-		glm::vec3(0, 1, 1),
-	};
+		//Block by block reference
+		std::vector<glm::ivec3> positions;
+		int r = (int)std::ceil(radius);
+		for (int x = -r; x <= r; ++x)
+			for (int y = -r; y <= r; ++y)
+				for (int z = -r; z <= r; ++z)
+					if (x * x + y * y + z * z <= radius * radius)
+					{
+						const Block * block = GetBlock(center + glm::ivec3(x, y, z));
+						if (block && std::find(types.begin(), types.end(), block->type) != types.end())
+							positions.push_back(center + glm::ivec3(x, y, z));
+					}
+	}
+	return Time::ElapsedSinceStartup() - start;
+}
 
-	std::vector<Plane> topBotPlanes = { planes[2], planes[3] };
+void World::UpdateBlock(glm::ivec3 position)
+{
+	Chunck* chunck = GetChunck(FloorDiv(position.x, SubChunck::size), FloorDiv(position.z, SubChunck::size));
+	if (chunck)
+	{
+		SubChunck * subChunck = chunck->GetSubChunck(FloorDiv(position.y, SubChunck::size));
+		if (subChunck)
+		{
+			Streamer().UpdateSubChunckMesh(subChunck);
+			subChunck->GenerateCollider();
+		}
+	}
+}
 
-	for (Chunck * chunck : enabledChuncks)
+void World::EnableAllChuncks()
+{
+	m_cullValid = false;
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
 	{
-		for (int y = 0; y < Chunck::height; ++y)
+		Chunck * chunck = chuncks.At(i);
+		if (chunck)
+			chunck->SetEnabled(true);
+	}
+}
+
+void World::ClipChuncks(const Camera & camera)
+{
+	//The last clipping holds while the camera stays close to where it was, its planes were pushed out by the margin
+	//A rotation by an angle moves the points up to the far plane by at most Far * angle, whatever its axis
+	const float margin = cullReuseDistance + camera.Far() * cullReuseAngle;
+	const float halfSin = std::sin(cullReuseAngle / 2.f);
+	const float maxRotation = 8.f * halfSin * halfSin;
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	const glm::ivec3 cell = ChunckAt(camera.position());
+
+	//Squared distance between the two camera bases, 8 * sin(angle / 2)^2 for a rotation of the angle, precise for small angles unlike the trace
+	const glm::vec3 forwardMove = camera.forward() - m_cullForward;
+	const glm::vec3 upMove = camera.Up() - m_cullUp;
+	const glm::vec3 rightMove = camera.right() - m_cullRight;
+	const float rotation = glm::dot(forwardMove, forwardMove) + glm::dot(upMove, upMove) + glm::dot(rightMove, rightMove);
+	if (m_cullValid && chuncks.Version() == m_cullVersion &&
+		camera.projectionMatrix() == m_cullProjection &&//Field of view, aspect ratio and planes
+		glm::distance(camera.position(), m_cullPosition) < cullReuseDistance &&
+		rotation < maxRotation &&
+		(!(m_occlusionCulling || m_rasterOcclusion) || (cell == m_cullCell && SubChunck::ConnectivityVersion() == m_cullConnectivity)) &&
+		(!m_rasterOcclusion || (camera.position() == m_cullPosition && rotation == 0.f)))//Occluders have no margin
+		return;
+
+	m_cullValid = true;
+	m_cullVersion = chuncks.Version();
+	m_cullPosition = camera.position();
+	m_cullForward = camera.forward();
+	m_cullUp = camera.Up();
+	m_cullRight = camera.right();
+	m_cullProjection = camera.projectionMatrix();
+	m_cullCell = cell;
+	m_cullConnectivity = SubChunck::ConnectivityVersion();
+
+	const Frustum frustum = camera.GetFrustum(margin);
+	const glm::vec3 subChunckSize((float)SubChunck::size * Block::size);
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+	{
+		Chunck * chunck = chuncks.At(i);
+		if (!chunck)
+			continue;
+
+		//The whole column first, only the columns crossing a plane test their subChuncks
+		glm::vec3 min = subChunckSize * glm::vec3(chunck->Position());
+		glm::vec3 max = min + subChunckSize * glm::vec3(1, Chunck::height, 1);
+		Frustum::Result result = frustum.TestBox(min, max);
+		chunck->SetEnabled(result != Frustum::outside);
+		if (result == Frustum::intersect)
 		{
-			bool enabled = false;
-			for (glm::vec3 point : subChunckPoints)
-			{
-				glm::ivec3 subChunckPos = glm::ivec3(chunck->Position().x, y, chunck->Position().z);
+			uint32_t visible = frustum.TestColumn(min, subChunckSize, Chunck::height);
+			for (int y = 0; y < Chunck::height; ++y)
+				chunck->SetSubChunckEnabled(y, (visible & (1u << y)) != 0);
+		}
+	}
+	m_frustumCount = CountDrawnSubChuncks();
 
-				//If the chunck point is very close, set enabled true
-				glm::vec3 center = (float)SubChunck::size * (glm::vec3(subChunckPos) + glm::vec3(0.5, 0.5, 0.5));
-				float distance = glm::distance(center, camera.position());
-				if (distance < SubChunck::size)
+	if (m_occlusionCulling)
+		CullOccluded(camera);
+	if (m_rasterOcclusion)
+		CullRasterized(camera);
+	m_drawnCount = CountDrawnSubChuncks();
+}
+
+void World::CullRasterized(const Camera & camera)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_occlusion.Clear(camera.projectionMatrix() * camera.viewMatrix(), camera.position());
+
+	//The closest solid boxes in the frustum are the occluders
+	const glm::vec3 subChunckSize((float)SubChunck::size * Block::size);
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	static std::vector<std::pair<float, SubChunck *>> occluders;
+	occluders.clear();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+		if (Chunck * chunck = chuncks.At(i))
+			for (int y = 0; y < Chunck::height; ++y)
+			{
+				SubChunck * subChunck = chunck->GetSubChunck(y);
+				if (subChunck->Enabled() && subChunck->SolidLayers() > 0)
 				{
-					enabled = true;
-					break;
+					float distance = glm::distance(camera.position(), subChunckSize * (glm::vec3(subChunck->Position()) + glm::vec3(0.5f)));
+					if (distance < occluderDistance)
+						occluders.push_back(std::make_pair(distance, subChunck));
 				}
+			}
+	std::sort(occluders.begin(), occluders.end(), [](const std::pair<float, SubChunck *> & left, const std::pair<float, SubChunck *> & right) { return left.first < right.first; });
+	if ((int)occluders.size() > maxOccluders)
+		occluders.resize(maxOccluders);
+	for (const std::pair<float, SubChunck *> & occluder : occluders)
+	{
+		glm::vec3 min = subChunckSize * glm::vec3(occluder.second->Position());
+		m_occlusion.DrawBox(min, min + glm::vec3(subChunckSize.x, occluder.second->SolidLayers() * Block::size, subChunckSize.z));
+	}
 
-				//If the chunck point is on the wrong side of a view frustrum plane
-				glm::vec3 worldPoint = (float)SubChunck::size * (glm::vec3(subChunckPos) + point);
-				bool outside = false;
-				for (Plane plane : topBotPlanes)
+	//Every subChunck left by the previous passes is tested before being drawn
+	m_rasterCulled = 0;
+	m_rasterCulledTriangles = 0;
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+		if (Chunck * chunck = chuncks.At(i))
+			for (int y = 0; y < Chunck::height; ++y)
+			{
+				SubChunck * subChunck = chunck->GetSubChunck(y);
+				if (!subChunck->Enabled() || !subChunck->HasMesh())
+					continue;
+				glm::vec3 min = subChunckSize * glm::vec3(subChunck->Position());
+				if (!m_occlusion.TestBox(min, min + subChunckSize))
 				{
-					if (plane.Right(worldPoint))
+					chunck->SetSubChunckEnabled(y, false);
+					++m_rasterCulled;
+					m_rasterCulledTriangles += subChunck->TriangleCount();
+				}
+			}
+
+	m_rasterTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void World::CullOccluded(const Camera & camera)
+{
+	//Everything in the frustum is drawn when the camera is out of the loaded chuncks
+	const glm::ivec3 cell = ChunckAt(camera.position());
+	Chunck * chunck = GetChunck(cell.x, cell.z);
+	if (!chunck)
+		return;
+
+	//Breadth first walk from the subChunck of the camera, inside the frustum, through the faces linked by open blocks.
+	//A step never goes in the direction opposite to a previous step, the walk moves away from the camera
+	struct Step
+	{
+		SubChunck * subChunck;
+		int from;//Face entered through, -1 for the camera subChunck
+		int directions;//Faces crossed since the camera
+	};
+	static std::vector<Step> steps;
+	steps.clear();
+	++m_visibleMark;
+
+	int from = cell.y >= Chunck::height ? SubChunck::top : (cell.y < 0 ? SubChunck::bottom : -1);
+	SubChunck * first = chunck->GetSubChunck(glm::clamp(cell.y, 0, Chunck::height - 1));
+	first->visibleMark = m_visibleMark;
+	steps.push_back({ first, from, 0 });
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		const Step step = steps[i];
+		for (int face = SubChunck::right; face <= SubChunck::back; ++face)
+		{
+			if ((step.directions & (1 << (face ^ 1))) || (step.from >= 0 && !step.subChunck->Connected(step.from, face)))
+				continue;
+
+			SubChunck * next = step.subChunck->Neighbour((SubChunck::Face)face);
+			if (!next || next->visibleMark == m_visibleMark || !next->Enabled())
+				continue;
+			next->visibleMark = m_visibleMark;
+			steps.push_back({ next, face ^ 1, step.directions | (1 << face) });
+		}
+	}
+
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+		if (Chunck * other = chuncks.At(i))
+			for (int y = 0; y < Chunck::height; ++y)
+				if (other->GetSubChunck(y)->Enabled() && other->GetSubChunck(y)->visibleMark != m_visibleMark)
+					other->SetSubChunckEnabled(y, false);
+}
+
+void World::UpdateSkyVisibility()
+{
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	if (m_skyVersion == chuncks.Version() && m_skyConnectivity == SubChunck::ConnectivityVersion())
+		return;
+	m_skyVersion = chuncks.Version();
+	m_skyConnectivity = SubChunck::ConnectivityVersion();
+
+	//Walk from every face open to the sky or to the unloaded chuncks. The faces a subChunck was entered through are all kept,
+	//a subChunck missed here could be the first surface hit by the light
+	struct Step
+	{
+		SubChunck * subChunck;
+		int from;
+	};
+	static std::vector<Step> steps;
+	steps.clear();
+
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+		if (Chunck * chunck = chuncks.At(i))
+			for (int y = 0; y < Chunck::height; ++y)
+			{
+				SubChunck * subChunck = chunck->GetSubChunck(y);
+				subChunck->skyFaces = 0;
+				for (int face = SubChunck::right; face <= SubChunck::back; ++face)
+					if (face != SubChunck::bottom && !subChunck->Neighbour((SubChunck::Face)face))
 					{
-						outside = true;
-						break;
+						subChunck->skyFaces |= 1 << face;
+						steps.push_back({ subChunck, face });
 					}
-				}
-				if (!outside)
-				{
-					enabled = true;
-					break;
-				}
 			}
-			chunck->SetSubChunckEnabled(y, enabled);
+
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		const Step step = steps[i];
+		for (int face = SubChunck::right; face <= SubChunck::back; ++face)
+		{
+			SubChunck * next = step.subChunck->Neighbour((SubChunck::Face)face);
+			if (!next || !step.subChunck->Connected(step.from, face) || (next->skyFaces & (1 << (face ^ 1))))
+				continue;
+			next->skyFaces |= 1 << (face ^ 1);
+			steps.push_back({ next, face ^ 1 });
 		}
 	}
 }
 
-void World::Update(float delta)
+int World::CountDrawnSubChuncks()
 {
-	m_array.Update(delta);
+	int count = 0;
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+		if (Chunck * chunck = chuncks.At(i))
+			for (int y = 0; y < Chunck::height; ++y)
+				if (chunck->GetSubChunck(y)->Enabled() && chunck->GetSubChunck(y)->HasMesh())
+					++count;
+	return count;
+}
+
+void World::DrawShadowCasters(const Shader & shader, const std::vector<glm::mat4> & projViews)
+{
+	shader.setMat4("model", glm::mat4(1.f));
+
+	//Culled against the light volumes, casters out of the camera view still cast their shadows
+	if (m_occlusionCulling)
+		UpdateSkyVisibility();
+	static std::vector<MeshArena::DrawCall> draws;
+	static std::vector<Frustum> frustums;
+	draws.clear();
+	frustums.clear();
+	for (const glm::mat4 & projView : projViews)
+		frustums.push_back(Frustum(projView));
+	const glm::vec3 subChunckSize((float)SubChunck::size * Block::size);
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+	{
+		Chunck * chunck = chuncks.At(i);
+		if (!chunck)
+			continue;
 
-	//Update chuncks
-	for (int x = 0; x < size; ++x)
-		for (int z = 0; z < size; ++z)
+		glm::vec3 min = subChunckSize * glm::vec3(chunck->Position());
+		uint32_t casters = 0;
+		for (const Frustum & frustum : frustums)
 		{
-			Chunck * chunck = GetChunck(m_array.OriginX() + x, m_array.OriginZ() + z);
-			if( chunck )
-				chunck->Update(delta);
+			Frustum::Result result = frustum.TestBox(min, min + subChunckSize * glm::vec3(1, Chunck::height, 1));
+			if (result != Frustum::outside)
+				casters |= result == Frustum::inside ? (1u << Chunck::height) - 1 : frustum.TestColumn(min, subChunckSize, Chunck::height);
 		}
+		if (casters == 0)
+			continue;
+
+		//Sealed from the sky, a surface always hides them from the light
+		if (m_occlusionCulling)
+			for (int y = 0; y < Chunck::height; ++y)
+				if (chunck->GetSubChunck(y)->skyFaces == 0)
+					casters &= ~(1u << y);
+		chunck->DrawCasters(draws, casters);
+	}
+	Streamer().Arena().Draw(draws, true);
+}
+
+void World::MeshChanged(glm::ivec3 subChunckPosition)
+{
+	m_meshChanges.push_back({ ++m_meshVersion, subChunckPosition });
+	if ((int)m_meshChanges.size() > maxMeshChanges)
+		m_meshChanges.pop_front();
+}
+
+uint32_t World::MeshVersion() { return m_meshVersion; }
+
+bool World::MeshesChanged(const glm::mat4 & projView, uint32_t since)
+{
+	if (since == m_meshVersion)
+		return false;
+
+	//Changes older than the kept ones may be anywhere
+	if (m_meshChanges.empty() || m_meshChanges.front().version > since + 1)
+		return true;
+
+	const Frustum frustum(projView);
+	const glm::vec3 subChunckSize((float)SubChunck::size * Block::size);
+	for (std::deque<MeshChange>::const_reverse_iterator it = m_meshChanges.rbegin(); it != m_meshChanges.rend() && it->version > since; ++it)
+	{
+		glm::vec3 min = subChunckSize * glm::vec3(it->subChunck);
+		if (frustum.TestBox(min, min + subChunckSize) != Frustum::outside)
+			return true;
+	}
+	return false;
+}
+
+void World::Update(float delta)
+{
+	++m_tick;
+
+	Streamer().Update(delta);
+
+	//Only subChuncks with pending work are updated
+	Streamer().UpdateActive(delta);
 				
 }
 
+void World::ScheduleUpdate(SubChunck * subChunck)
+{
+	Streamer().ScheduleUpdate(subChunck);
+}
+
+int World::PlayerAnchor()
+{
+	//Created on first use, the world starts loading with the game and not when the program starts
+	if (m_playerAnchor < 0)
+		m_playerAnchor = Streamer().AddAnchor(glm::ivec2(0, 0), World::defaultSize);
+	return m_playerAnchor;
+}
+
 void World::CenterChuncksAround(glm::ivec3 chunckPos)
+{
+	MoveAnchor(PlayerAnchor(), chunckPos);
+}
+
+int World::AddAnchor(glm::ivec3 chunckPos, int size)
+{
+	return Streamer().AddAnchor(glm::ivec2(chunckPos.x, chunckPos.z), size);
+}
+
+void World::RemoveAnchor(int anchor)
+{
+	Streamer().RemoveAnchor(anchor);
+}
+
+void World::MoveAnchor(int anchor, glm::ivec3 chunckPos)
 {
 	//Generates colliders around the center
 	for (int x = -1; x < 2; ++x)
@@ -208,17 +632,38 @@ void World::CenterChuncksAround(glm::ivec3 chunckPos)
 					chunck->GenerateCollider(chunckPos.y + y);
 			}
 
+	//Large moves (teleports, respawns) recenter the anchor at once
+	int size = Streamer().Size(anchor);
+	int originX = chunckPos.x - size / 2;
+	int originZ = chunckPos.z - size / 2;
+	if (std::abs(originX - Streamer().OriginX(anchor)) > recenterDistance || std::abs(originZ - Streamer().OriginZ(anchor)) > recenterDistance)
+	{
+		Streamer().Recenter(anchor, originX, originZ);
+		return;
+	}
 
 	//Generates missing chuncks
-	if (chunckPos.x < m_array.OriginX() + World::size / 2 - 1 )
-		m_array.MoveLeft();
-	else if (chunckPos.x > m_array.OriginX() + World::size / 2 + 1 )
-		m_array.MoveRight();
-	else if (chunckPos.z > m_array.OriginZ() + World::size / 2 + 1)
-		m_array.MoveFront();
-	else if (chunckPos.z < m_array.OriginZ() + World::size / 2 - 1)
-		m_array.MoveBack();
-	
+	if (chunckPos.x < Streamer().OriginX(anchor) + size / 2 - 1 )
+		Streamer().Move(anchor, -1, 0);
+	else if (chunckPos.x > Streamer().OriginX(anchor) + size / 2 + 1 )
+		Streamer().Move(anchor, 1, 0);
+	else if (chunckPos.z > Streamer().OriginZ(anchor) + size / 2 + 1)
+		Streamer().Move(anchor, 0, 1);
+	else if (chunckPos.z < Streamer().OriginZ(anchor) + size / 2 - 1)
+		Streamer().Move(anchor, 0, -1);
+}
+
+void World::PrefetchChuncks(glm::vec3 position, glm::vec3 velocity, glm::vec3 viewDirection)
+{
+	//Where the player will be in a few seconds, in chuncks
+	glm::vec2 ahead = prefetchTime * glm::vec2(velocity.x, velocity.z) / (float)SubChunck::size;
+
+	//Chuncks in the view direction are needed first
+	glm::vec2 look(viewDirection.x, viewDirection.z);
+	if (glm::length(look) > 0.f)
+		look = glm::normalize(look);
+
+	Streamer().Prefetch(PlayerAnchor(), ahead + look);
 }
 
 void World::UpdateAround(glm::ivec3 position)
@@ -233,26 +678,48 @@ void World::UpdateAround(glm::ivec3 position)
 
 void World::DrawTransparent(const Shader & shader)
 {
-	for (int z = 0; z < size; ++z)
-		for (int x = 0; x < size; ++x)
-		{
-			Chunck * chunck = GetChunck(m_array.OriginX() + x, m_array.OriginZ() + z);
-			if(chunck)
-				chunck->DrawTransparent(shader);
-		}
-			 
+	//Offsets of the subChuncks are given per draw, the model matrix is left to the identity
+	shader.setMat4("model", glm::mat4(1.f));
+
+	//The commands were written by CullOnGpu, nothing is walked on the CPU
+	if (m_gpuCulling)
+	{
+		Streamer().Culler().DrawTransparent(Streamer().Arena());
+		return;
+	}
+
+	static std::vector<MeshArena::DrawCall> draws;
+	draws.clear();
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+	{
+		Chunck * chunck = chuncks.At(i);
+		if (chunck)
+			chunck->DrawTransparent(draws);
+	}
+	Streamer().Arena().Draw(draws);
 }
 
 void World::DrawOpaque(const Shader & shader)
 {
-	for (int z = 0; z < size; ++z)
-		for (int x = 0; x < size; ++x)
-		{
-			Chunck * chunck = GetChunck(m_array.OriginX() + x, m_array.OriginZ() + z);
-			if (chunck)
-				chunck->DrawOpaque(shader);
-		}
-			
+	shader.setMat4("model", glm::mat4(1.f));
+
+	if (m_gpuCulling)
+	{
+		Streamer().Culler().DrawOpaque(Streamer().Arena());
+		return;
+	}
+
+	static std::vector<MeshArena::DrawCall> draws;
+	draws.clear();
+	const ChunckMap & chuncks = Streamer().Chuncks();
+	for (int i = 0; i < chuncks.Capacity(); ++i)
+	{
+		Chunck * chunck = chuncks.At(i);
+		if (chunck)
+			chunck->DrawOpaque(draws);
+	}
+	Streamer().Arena().Draw(draws);
 }
 
 void World::OnDrawDebug() const
@@ -287,7 +754,91 @@ void World::OnDrawDebug() const
 	}*/
 }
 
-glm::ivec3 World::GetOrigin() { return { m_array.OriginX(), 0, m_array.OriginZ() }; }
+glm::ivec3 World::GetOrigin() { return { Streamer().OriginX(PlayerAnchor()), 0, Streamer().OriginZ(PlayerAnchor()) }; }
+int World::ResidentChuncksCount() { return Streamer().ResidentCount(); }
+int World::ActiveSubChuncksCount() { return Streamer().ActiveCount(); }
+int World::GeneratorBacklog() { return Streamer().GeneratorBacklog(); }
+float World::MeshTime() { return Streamer().MeshTime(); }
+float World::ChunckGenerationTime() { return Streamer().GenerationTime(); }
+float World::ChunckLoadTime() { return Streamer().LoadTime(); }
+int World::Size() { return Streamer().Size(PlayerAnchor()); }
+
+void World::SetSize(int size)
+{
+	Streamer().Resize(PlayerAnchor(), glm::clamp(size, minSize, maxSize));
+}
+
+int World::CachedChuncksCount() { return Streamer().Cache().Count(); }
+float World::CacheSize() { return Streamer().Cache().Size() / (1024.f * 1024.f); }
+float World::CacheCapacity() { return Streamer().Cache().Capacity() / (1024.f * 1024.f); }
+
+void World::SetCacheCapacity(float megabytes)
+{
+	Streamer().Cache().SetCapacity((size_t)(std::max(megabytes, 0.f) * 1024.f * 1024.f));
+}
+
+bool World::MeshCacheEnabled() { return Streamer().Meshes().Enabled(); }
+void World::SetMeshCacheEnabled(bool state) { Streamer().Meshes().SetEnabled(state); }
+float World::MeshCacheHitRate() { return Streamer().Meshes().HitRate(); }
+float World::MeshCacheTimeSaved() { return Streamer().Meshes().TimeSaved(); }
+
+bool World::OcclusionCullingEnabled() { return m_occlusionCulling; }
+
+void World::SetOcclusionCullingEnabled(bool state)
+{
+	m_occlusionCulling = state;
+	m_cullValid = false;
+}
+
+bool World::RasterOcclusionEnabled() { return m_rasterOcclusion; }
+
+void World::SetRasterOcclusionEnabled(bool state)
+{
+	m_rasterOcclusion = state;
+	m_cullValid = false;
+}
+
+float World::RasterOcclusionTime() { return m_rasterTime; }
+int World::RasterOccluderTriangles() { return m_occlusion.Triangles(); }
+int World::RasterCulledCount() { return m_rasterCulled; }
+int World::RasterCulledTriangles() { return m_rasterCulledTriangles; }
+
+bool World::GpuCullingSupported() { return GpuCuller::Supported(); }
+bool World::GpuCullingEnabled() { return m_gpuCulling; }
+
+void World::SetGpuCullingEnabled(bool state)
+{
+	m_gpuCulling = state && GpuCuller::Supported();
+
+	//ClipChuncks withdrew the records of the chuncks it disabled, the GPU culling draws them all
+	EnableAllChuncks();
+
+	//The last pyramid was built from a frame drawn without it
+	Streamer().Culler().Invalidate();
+}
+
+void World::CullOnGpu(const Camera & camera)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	Streamer().Culler().Cull(camera.projectionMatrix() * camera.viewMatrix(), glm::vec3((float)SubChunck::size * Block::size));
+	m_gpuCullingTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void World::BuildDepthPyramid(unsigned int depthTexture, int width, int height)
+{
+	if (m_gpuCulling)
+		Streamer().Culler().BuildPyramid(depthTexture, width, height);
+}
+
+float World::GpuCullingTime() { return m_gpuCullingTime; }
+int World::GpuCullingRecords() { return Streamer().Culler().Slots(); }
+
+int World::FrustumSubChuncksCount() { return m_frustumCount; }
+int World::DrawnSubChuncksCount() { return m_drawnCount; }
+
+float World::MeshArenaUsed() { return Streamer().Arena().Used() / 1000000.f; }
+float World::MeshArenaCapacity() { return Streamer().Arena().Capacity() / 1000000.f; }
+bool World::MeshArenaIndirect() { return Streamer().Arena().Indirect(); }
 
 World::~World()
 {
@@ -195,31 +195,53 @@ PostProcessingFBO::~PostProcessingFBO()
 
 //////////////////////////////// ShadowMapFBO ////////////////////////////////
 
-ShadowMapFBO::ShadowMapFBO(int width, int height) : FBO(width, height)
+ShadowMapFBO::ShadowMapFBO(int width, int height, int layers) : FBO(width, height)
 {
 	glGenFramebuffers(1, &m_fbo);
 
 	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16,width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthMap);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, width, height, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	//Layered attachment, the layer of each primitive is chosen by the geometry shader
 	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+
+	m_layerFbos.resize(layers);
+	glGenFramebuffers(layers, m_layerFbos.data());
+	for (int layer = 0; layer < layers; ++layer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_layerFbos[layer]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, layer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void ShadowMapFBO::UseTexture(TextureUnit textureUnit)const
 {
 	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthMap);
+}
+
+void ShadowMapFBO::ClearLayer(int layer) const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_layerFbos[layer]);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 }
 
+int ShadowMapFBO::Layers() const { return (int)m_layerFbos.size(); }
+
 void ShadowMapFBO::Use() const
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
@@ -236,6 +258,8 @@ void ShadowMapFBO::Clear() const
 ShadowMapFBO::~ShadowMapFBO()
 {
 	glDeleteFramebuffers(1, &m_fbo);
+	glDeleteFramebuffers((GLsizei)m_layerFbos.size(), m_layerFbos.data());
+	glDeleteTextures(1, &depthMap);
 }
 
 
@@ -0,0 +1,221 @@
+#include "graphics/GpuCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/Frustum.h"
+
+namespace
+{
+	const int groupSize = 64;//local_size_x of cull.cs
+	const int pyramidGroupSize = 8;//local_size_x and local_size_y of hiz.cs
+	const GLenum textureUnit = GL_TEXTURE7;//Left to the culling, the other units are bound by the passes
+	const int initialCapacity = 4096;//Slots, the buffers double when full
+}
+
+GpuCuller::GpuCuller() :
+	m_initialized(false),
+	m_cullShader(nullptr),
+	m_pyramidShader(nullptr),
+	m_records(0),
+	m_opaqueCommands(0),
+	m_transparentCommands(0),
+	m_capacity(0),
+	m_dirtyFirst(0),
+	m_dirtyLast(-1),
+	m_pyramid(0),
+	m_pyramidWidth(0),
+	m_pyramidHeight(0),
+	m_pyramidLevels(0),
+	m_pyramidValid(false),
+	m_projView(1.f),
+	m_pyramidProjView(1.f)
+{
+	static_assert(sizeof(Record) == 32, "Record must match the std430 layout of cull.cs");
+}
+
+bool GpuCuller::Supported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void GpuCuller::Init()
+{
+	m_initialized = true;
+	m_cullShader = new Shader("shaders/compute/cull.cs");
+	m_pyramidShader = new Shader("shaders/compute/hiz.cs");
+	glGenBuffers(1, &m_records);
+	glGenBuffers(1, &m_opaqueCommands);
+	glGenBuffers(1, &m_transparentCommands);
+	glGenTextures(1, &m_pyramid);
+}
+
+void GpuCuller::Set(int & slot, const Record & record)
+{
+	if (slot < 0)
+	{
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (int)m_slots.size();
+			m_slots.push_back(Record());
+		}
+	}
+
+	m_slots[slot] = record;
+	m_dirtyFirst = std::min(m_dirtyFirst, slot);
+	m_dirtyLast = std::max(m_dirtyLast, slot);
+}
+
+void GpuCuller::Remove(int & slot)
+{
+	if (slot < 0)
+		return;
+
+	//Nothing to draw, the command of the slot stays culled until it is reused
+	m_slots[slot] = Record();
+	m_dirtyFirst = std::min(m_dirtyFirst, slot);
+	m_dirtyLast = std::max(m_dirtyLast, slot);
+	m_freeSlots.push_back(slot);
+	slot = -1;
+}
+
+void GpuCuller::Reserve(int capacity)
+{
+	int newCapacity = m_capacity > 0 ? m_capacity : initialCapacity;
+	while (newCapacity < capacity)
+		newCapacity *= 2;
+	m_capacity = newCapacity;
+
+	//Every slot is uploaded again, the commands are written by the next dispatch
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_records);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_capacity * sizeof(Record), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)m_slots.size() * sizeof(Record), m_slots.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_opaqueCommands);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_capacity * sizeof(DrawCommand), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_transparentCommands);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_capacity * sizeof(DrawCommand), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::Cull(const glm::mat4 & projView, glm::vec3 boxSize)
+{
+	if (!Supported())
+		return;
+	if (!m_initialized)
+		Init();
+
+	//Only the slots changed since the last frame are sent
+	if ((int)m_slots.size() > m_capacity)
+		Reserve((int)m_slots.size());
+	else if (m_dirtyLast >= m_dirtyFirst)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_records);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)m_dirtyFirst * sizeof(Record), (GLsizeiptr)(m_dirtyLast - m_dirtyFirst + 1) * sizeof(Record), &m_slots[m_dirtyFirst]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	m_dirtyFirst = (int)m_slots.size();
+	m_dirtyLast = -1;
+	m_projView = projView;
+	if (m_slots.empty())
+		return;
+
+	const Frustum frustum(projView);
+	m_cullShader->Use();
+	m_cullShader->setInt("recordsCount", (int)m_slots.size());
+	m_cullShader->setVec3("size", boxSize);
+	for (int i = 0; i < Frustum::planesCount; ++i)
+		m_cullShader->setVec4("planes[" + std::to_string(i) + "]", frustum.planes[i]);
+
+	//The pyramid of the previous frame, boxes out of its view are kept
+	m_cullShader->setBool("hiZ", m_pyramidValid);
+	m_cullShader->setMat4("pyramidProjView", m_pyramidProjView);
+	m_cullShader->setInt("pyramidLevels", m_pyramidLevels);
+	m_cullShader->setInt("pyramid", textureUnit - GL_TEXTURE0);
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, m_pyramid);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_records);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_opaqueCommands);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_transparentCommands);
+	glDispatchCompute(((GLuint)m_slots.size() + groupSize - 1) / groupSize, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::BuildPyramid(unsigned int depthTexture, int width, int height)
+{
+	if (!m_initialized || width <= 0 || height <= 0)
+		return;
+
+	//Immutable storage, created again when the window is resized
+	if (width != m_pyramidWidth || height != m_pyramidHeight)
+	{
+		glDeleteTextures(1, &m_pyramid);
+		glGenTextures(1, &m_pyramid);
+		m_pyramidWidth = width;
+		m_pyramidHeight = height;
+		m_pyramidLevels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+		glBindTexture(GL_TEXTURE_2D, m_pyramid);
+		glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	m_pyramidShader->Use();
+	m_pyramidShader->setInt("depth", textureUnit - GL_TEXTURE0);
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	//Each level reads the one written before it
+	for (int level = 0; level < m_pyramidLevels; ++level)
+	{
+		int levelWidth = std::max(1, width >> level);
+		int levelHeight = std::max(1, height >> level);
+		m_pyramidShader->setInt("level", level);
+		glBindImageTexture(0, m_pyramid, std::max(0, level - 1), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, m_pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelWidth + pyramidGroupSize - 1) / pyramidGroupSize, (levelHeight + pyramidGroupSize - 1) / pyramidGroupSize, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	//The depth was drawn with the view of the last culling
+	m_pyramidProjView = m_projView;
+	m_pyramidValid = true;
+}
+
+void GpuCuller::DrawOpaque(MeshArena & arena) const
+{
+	if (m_initialized && !m_slots.empty())
+		arena.DrawIndirect(m_opaqueCommands, m_records, sizeof(Record), (int)m_slots.size());
+}
+
+void GpuCuller::DrawTransparent(MeshArena & arena) const
+{
+	if (m_initialized && !m_slots.empty())
+		arena.DrawIndirect(m_transparentCommands, m_records, sizeof(Record), (int)m_slots.size());
+}
+
+void GpuCuller::Invalidate()
+{
+	m_pyramidValid = false;
+}
+
+int GpuCuller::Slots() const { return (int)m_slots.size() - (int)m_freeSlots.size(); }
+
+GpuCuller::~GpuCuller()
+{
+	if (m_initialized)
+	{
+		glDeleteBuffers(1, &m_records);
+		glDeleteBuffers(1, &m_opaqueCommands);
+		glDeleteBuffers(1, &m_transparentCommands);
+		glDeleteTextures(1, &m_pyramid);
+	}
+}
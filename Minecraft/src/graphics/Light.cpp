@@ -1,5 +1,7 @@
 #include "graphics/Light.h"
 
+#include <cmath>
+
 /////////////////////////// Light ///////////////////////////
 
 Light::Light(glm::vec3 colorLight) : 
@@ -13,13 +15,24 @@ Light::~Light(){}
 
 Shader* DirectionalLight::shader = nullptr;
 
-DirectionalLight::DirectionalLight(glm::vec3 directionLight, float size) :
-	fbo(2 * 2048, 2 * 2048),
+namespace
+{
+	const float depthSnap = 64.f;//Moves along the light direction are absorbed by the depth range
+	const float splitLambda = 0.75f;//Blend of the logarithmic and uniform splits
+	const float baseBias = 0.00015f;//For a cascade of radius biasRadius
+	const float biasRadius = 20.f;
+}
+
+DirectionalLight::DirectionalLight(glm::vec3 directionLight, int cascades, float distance) :
+	fbo(resolution, resolution, maxCascades),
 	direction(directionLight),
-	projection(glm::ortho(-size, size, -size, size, 0.1f, 1000.f))
+	m_rotation(glm::lookAt(glm::vec3(0.f), directionLight, glm::vec3(0.0f, 1.0f, 0.0f))),
+	m_distance(distance),
+	m_cascadesCount(glm::clamp(cascades, 1, (int)maxCascades)),
+	m_baked(0)
 {
 	if (!shader)
-		shader = new Shader("shaders/forward/shadows.vs", "shaders/forward/shadows.fs");
+		shader = new Shader("shaders/forward/shadows.vs", "shaders/forward/shadows.gs", "shaders/forward/shadows.fs");
 }
 
 DirectionalLight::~DirectionalLight()
@@ -32,22 +45,120 @@ DirectionalLight::~DirectionalLight()
 }
 
 
-void DirectionalLight::BakeShadows(glm::vec3 lookPoint)
+void DirectionalLight::BakeShadows(const Camera & camera)
 {
-	view = glm::lookAt(
-		lookPoint - 500.f*direction,
-		lookPoint,
-		glm::vec3(0.0f, 1.0f, 0.0f));
+	//Near and far of the perspective projection, the last cascade ends at the shadows distance
+	const glm::mat4 cameraProjection = camera.projectionMatrix();
+	const float cameraNear = cameraProjection[3][2] / (cameraProjection[2][2] - 1.f);
+	const float cameraFar = cameraProjection[3][2] / (cameraProjection[2][2] + 1.f);
+	const float shadowFar = std::min(cameraFar, m_distance);
+
+	//Rays along the edges of the camera frustum, points at a view depth are linear along them
+	const glm::mat4 inverse = glm::inverse(cameraProjection * camera.viewMatrix());
+	glm::vec3 nearCorners[4];
+	glm::vec3 farCorners[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		glm::vec4 nearCorner = inverse * glm::vec4(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, -1.f, 1.f);
+		glm::vec4 farCorner = inverse * glm::vec4(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, 1.f, 1.f);
+		nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+	}
 
-	shader->Use();
+	m_baked = 0;
+	float sliceNear = cameraNear;
+	for (int c = 0; c < m_cascadesCount; ++c)
+	{
+		float ratio = (c + 1) / (float)m_cascadesCount;
+		float sliceFar = glm::mix(cameraNear + (shadowFar - cameraNear) * ratio, cameraNear * std::pow(shadowFar / cameraNear, ratio), splitLambda);
+
+		//Bounding sphere of the slice, its size does not change when the camera turns
+		glm::vec3 corners[8];
+		glm::vec3 center(0.f);
+		for (int i = 0; i < 4; ++i)
+		{
+			corners[2 * i] = glm::mix(nearCorners[i], farCorners[i], (sliceNear - cameraNear) / (cameraFar - cameraNear));
+			corners[2 * i + 1] = glm::mix(nearCorners[i], farCorners[i], (sliceFar - cameraNear) / (cameraFar - cameraNear));
+			center += corners[2 * i] + corners[2 * i + 1];
+		}
+		center /= 8.f;
+		float radius = 0.f;
+		for (int i = 0; i < 8; ++i)
+			radius = std::max(radius, glm::length(corners[i] - center));
+		radius = std::ceil(radius);
+		sliceNear = sliceFar;
+
+		//The origin moves by whole texels, the cached texels stay on the same world positions
+		float texelSize = 2.f * radius / fbo.m_width;
+		glm::vec3 local = glm::vec3(m_rotation * glm::vec4(center, 1.f));
+		local.x = std::floor(local.x / texelSize) * texelSize;
+		local.y = std::floor(local.y / texelSize) * texelSize;
+		local.z = std::floor(local.z / depthSnap) * depthSnap;
+		glm::vec3 origin = glm::vec3(glm::inverse(m_rotation) * glm::vec4(local, 1.f));
+
+		Cascade & cascade = m_cascades[c];
+		++cascade.framesSinceBake;
+		if (cascade.valid && origin == cascade.origin && radius == cascade.radius && !World::MeshesChanged(cascade.projection * cascade.view, cascade.meshVersion))
+			continue;
+		if (cascade.valid && cascade.framesSinceBake < (1 << c))
+			continue;
+
+		cascade.origin = origin;
+		cascade.radius = radius;
+		cascade.valid = true;
+		cascade.framesSinceBake = 0;
+		cascade.meshVersion = World::MeshVersion();
+		cascade.projection = glm::ortho(-radius, radius, -radius, radius, 0.1f, 1000.f);
+		cascade.view = glm::lookAt(
+			origin - 500.f*direction,
+			origin,
+			glm::vec3(0.0f, 1.0f, 0.0f));
+		m_baked |= 1 << c;
+	}
+	if (m_baked == 0)
+		return;
 
+	//Only the layers of the cascades rendered again are cleared and drawn
+	static std::vector<glm::mat4> projViews;
+	projViews.clear();
+	shader->Use();
 	fbo.Use();
-	fbo.Clear();
-	shader->setMat4("projview", projection * view);
-	World::DrawOpaque(*shader);
+	for (int c = 0; c < maxCascades; ++c)
+	{
+		shader->setMat4("projviews[" + std::to_string(c) + "]", ProjectionView(c));
+		if (m_baked & (1 << c))
+		{
+			fbo.ClearLayer(c);
+			projViews.push_back(ProjectionView(c));
+		}
+	}
+	shader->setInt("cascadesMask", m_baked);
+	World::DrawShadowCasters(*shader, projViews);
+}
+
+void DirectionalLight::Invalidate()
+{
+	for (Cascade & cascade : m_cascades)
+		cascade.valid = false;
+}
+
+int DirectionalLight::Cascades() const { return m_cascadesCount; }
+
+void DirectionalLight::SetCascades(int count)
+{
+	m_cascadesCount = glm::clamp(count, 1, (int)maxCascades);
+	Invalidate();
 }
 
-glm::mat4 DirectionalLight::ProjectionView() { return projection * view; }
+glm::mat4 DirectionalLight::ProjectionView(int cascade) const { return m_cascades[cascade].projection * m_cascades[cascade].view; }
+float DirectionalLight::Bias(int cascade) const { return baseBias * m_cascades[cascade].radius / biasRadius; }
+int DirectionalLight::BakedCascades() const
+{
+	int count = 0;
+	for (int c = 0; c < maxCascades; ++c)
+		count += (m_baked >> c) & 1;
+	return count;
+}
 
 /////////////////////////// PointLight ///////////////////////////
 
@@ -0,0 +1,270 @@
+#include "graphics/MeshArena.h"
+
+MeshArena::MeshArena()
+{
+}
+
+void MeshArena::Init()
+{
+	m_initialized = true;
+	m_indirect = GLAD_GL_VERSION_4_3 != 0;
+
+	glGenVertexArrays(1, &m_VAO);
+	glGenVertexArrays(1, &m_depthVAO);
+	glGenBuffers(1, &m_offsetsVBO);
+	glGenBuffers(1, &m_commandsBuffer);
+	Grow(initialCapacity);
+
+	//Uploads go through glBufferSubData when the context cannot map it
+	m_staging.Init();
+}
+
+void MeshArena::SetVertexAttributes()
+{
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+
+	// position attribute
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	// normal attribute
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)(offsetof(Mesh::Vertex, normals)));
+	glEnableVertexAttribArray(1);
+
+	// texture coord attribute
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)(offsetof(Mesh::Vertex, texCoord)));
+	glEnableVertexAttribArray(2);
+
+	// draw offset attribute, one per instance so the base instance of a draw selects it
+	if (m_indirect)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_offsetsVBO);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		glVertexAttribDivisor(3, 1);
+		glEnableVertexAttribArray(3);
+	}
+
+	//Same buffers, position and draw offset only
+	glBindVertexArray(m_depthVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	if (m_indirect)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_offsetsVBO);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		glVertexAttribDivisor(3, 1);
+		glEnableVertexAttribArray(3);
+	}
+	glBindVertexArray(0);
+}
+
+void MeshArena::Grow(uint32_t minCapacity)
+{
+	uint32_t capacity = m_capacity > 0 ? m_capacity : initialCapacity;
+	while (capacity < minCapacity)
+		capacity *= 2;
+
+	//The new buffer starts with a copy of the old one, allocations keep their offsets
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(Mesh::Vertex), nullptr, GL_STATIC_DRAW);
+	if (m_VBO)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_VBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)m_capacity * sizeof(Mesh::Vertex));
+		glDeleteBuffers(1, &m_VBO);
+	}
+	m_VBO = buffer;
+
+	//The new space is a free range, merged with a free range ending the old buffer
+	uint32_t first = m_capacity;
+	uint32_t count = capacity - m_capacity;
+	if (!m_free.empty())
+	{
+		std::map<uint32_t, uint32_t>::iterator last = std::prev(m_free.end());
+		if (last->first + last->second == first)
+		{
+			first = last->first;
+			count += last->second;
+			m_free.erase(last);
+		}
+	}
+	m_free[first] = count;
+	m_capacity = capacity;
+
+	SetVertexAttributes();
+}
+
+UploadRing::Slice MeshArena::Stage(const std::vector<Mesh::Vertex> & vertices)
+{
+	return Stage(vertices.data(), vertices.size());
+}
+
+UploadRing::Slice MeshArena::Stage(const Mesh::Vertex * vertices, size_t count)
+{
+	return m_staging.Write(vertices, count * sizeof(Mesh::Vertex));
+}
+
+MeshArena::Allocation MeshArena::Reserve(uint32_t count)
+{
+	//First fit
+	std::map<uint32_t, uint32_t>::iterator it = m_free.begin();
+	while (it != m_free.end() && it->second < count)
+		++it;
+	if (it == m_free.end())
+	{
+		Grow(m_capacity + count);
+		return Reserve(count);
+	}
+
+	Allocation allocation;
+	allocation.first = it->first;
+	allocation.count = count;
+	if (it->second > count)
+		m_free[it->first + count] = it->second - count;
+	m_free.erase(it);
+	m_used += count;
+	return allocation;
+}
+
+MeshArena::Allocation MeshArena::Allocate(const std::vector<Mesh::Vertex> & vertices)
+{
+	if (vertices.empty())
+		return Allocation();
+	if (!m_initialized)
+		Init();
+
+	Allocation allocation = Reserve((uint32_t)vertices.size());
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)allocation.first * sizeof(Mesh::Vertex), (GLsizeiptr)allocation.count * sizeof(Mesh::Vertex), vertices.data());
+	return allocation;
+}
+
+MeshArena::Allocation MeshArena::Allocate(UploadRing::Slice & staged)
+{
+	if (staged.size == 0)
+		return Allocation();
+
+	//The copy is queued on the GPU, the slice is recycled once the fence of the frame is signaled
+	Allocation allocation = Reserve((uint32_t)(staged.size / sizeof(Mesh::Vertex)));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
+	m_staging.Copy(staged, GL_COPY_WRITE_BUFFER, (GLintptr)allocation.first * sizeof(Mesh::Vertex));
+	m_staging.Release(staged);
+	return allocation;
+}
+
+void MeshArena::Discard(UploadRing::Slice & staged)
+{
+	m_staging.Release(staged);
+}
+
+void MeshArena::Free(Allocation & allocation)
+{
+	if (allocation.count == 0)
+		return;
+
+	uint32_t first = allocation.first;
+	uint32_t count = allocation.count;
+	m_used -= count;
+	allocation = Allocation();
+
+	//Merges with the free ranges before and after
+	std::map<uint32_t, uint32_t>::iterator next = m_free.lower_bound(first);
+	if (next != m_free.end() && first + count == next->first)
+	{
+		count += next->second;
+		next = m_free.erase(next);
+	}
+	if (next != m_free.begin())
+	{
+		std::map<uint32_t, uint32_t>::iterator previous = std::prev(next);
+		if (previous->first + previous->second == first)
+		{
+			previous->second += count;
+			return;
+		}
+	}
+	m_free[first] = count;
+}
+
+void MeshArena::Draw(const std::vector<DrawCall> & draws, bool depthOnly)
+{
+	if (!m_initialized || draws.empty())
+		return;
+
+	glBindVertexArray(depthOnly ? m_depthVAO : m_VAO);
+	if (m_indirect)
+	{
+		m_commands.clear();
+		m_offsets.clear();
+		for (const DrawCall & draw : draws)
+		{
+			m_commands.push_back({ draw.allocation.count, 1, draw.allocation.first, (uint32_t)m_offsets.size() });
+			m_offsets.push_back(draw.offset);
+		}
+
+		//Buffers orphaned every pass, the driver does not wait for the previous draws
+		glBindBuffer(GL_ARRAY_BUFFER, m_offsetsVBO);
+		glBufferData(GL_ARRAY_BUFFER, m_offsets.size() * sizeof(glm::vec3), m_offsets.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandsBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawCommand), m_commands.data(), GL_STREAM_DRAW);
+
+		glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)m_commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else
+	{
+		//The offset is the current value of the disabled attribute
+		for (const DrawCall & draw : draws)
+		{
+			glVertexAttrib3f(3, draw.offset.x, draw.offset.y, draw.offset.z);
+			glDrawArrays(GL_TRIANGLES, draw.allocation.first, draw.allocation.count);
+		}
+		glVertexAttrib3f(3, 0.f, 0.f, 0.f);
+	}
+	glBindVertexArray(0);
+}
+
+void MeshArena::DrawIndirect(unsigned int commands, unsigned int offsets, int offsetsStride, int count)
+{
+	if (!m_initialized || !m_indirect || count == 0)
+		return;
+
+	//The offsets attribute reads the given buffer for this draw only
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, offsets);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, offsetsStride, (void*)0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+	glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)count, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_offsetsVBO);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	glBindVertexArray(0);
+}
+
+void MeshArena::EndFrame()
+{
+	if (!m_initialized)
+		Init();
+	m_staging.EndFrame();
+}
+
+size_t MeshArena::Capacity() const { return (size_t)m_capacity * sizeof(Mesh::Vertex); }
+size_t MeshArena::Used() const { return (size_t)m_used * sizeof(Mesh::Vertex); }
+bool MeshArena::Indirect() const { return m_indirect; }
+
+MeshArena::~MeshArena()
+{
+	if (m_initialized)
+	{
+		glDeleteVertexArrays(1, &m_VAO);
+		glDeleteVertexArrays(1, &m_depthVAO);
+		glDeleteBuffers(1, &m_VBO);
+		glDeleteBuffers(1, &m_offsetsVBO);
+		glDeleteBuffers(1, &m_commandsBuffer);
+	}
+}
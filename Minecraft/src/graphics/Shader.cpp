@@ -9,6 +9,24 @@ Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath) :
 	Load();
 }
 
+Shader::Shader(const GLchar* vertexPath, const GLchar* geometryPath, const GLchar* fragmentPath) :
+	ID(-1),
+	m_vertexPath(vertexPath),
+	m_fragmentPath(fragmentPath),
+	m_geometryPath(geometryPath)
+{
+	m_shaders.push_back(this);
+	Load();
+}
+
+Shader::Shader(const GLchar* computePath) :
+	ID(-1),
+	m_computePath(computePath)
+{
+	m_shaders.push_back(this);
+	Load();
+}
+
 
 std::vector<Shader *> Shader::m_shaders;
 void Shader::ReloadAll()
@@ -20,6 +38,12 @@ void Shader::ReloadAll()
 
 void Shader::Load()
 {
+	if (!m_computePath.empty())
+	{
+		LoadCompute();
+		return;
+	}
+
 	//Shader program
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -77,12 +101,46 @@ void Shader::Load()
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
 
+	//Optional geometry shader
+	unsigned int geometryShader = 0;
+	if (!m_geometryPath.empty())
+	{
+		std::string geometryCode;
+		std::ifstream gShaderFile;
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try
+		{
+			gShaderFile.open(m_geometryPath);
+			std::stringstream gShaderStream;
+			gShaderStream << gShaderFile.rdbuf();
+			gShaderFile.close();
+			geometryCode = gShaderStream.str();
+		}
+		catch (const std::ifstream::failure &)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		}
+
+		const char* gShaderCode = geometryCode.c_str();
+		geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
+		glShaderSource(geometryShader, 1, &gShaderCode, NULL);
+		glCompileShader(geometryShader);
+		glGetShaderiv(geometryShader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(geometryShader, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n" << infoLog << std::endl;
+		}
+	}
+
 	if (ID != -1)
 		glDeleteProgram(ID);
 
 	ID = glCreateProgram();
 
 	glAttachShader(ID, vertexShader);
+	if (geometryShader)
+		glAttachShader(ID, geometryShader);
 	glAttachShader(ID, fragmentShader);
 	glLinkProgram(ID);
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -92,6 +150,53 @@ void Shader::Load()
 	}
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
+	if (geometryShader)
+		glDeleteShader(geometryShader);
+}
+
+void Shader::LoadCompute()
+{
+	std::string computeCode;
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		cShaderFile.open(m_computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
+		computeCode = cShaderStream.str();
+	}
+	catch (const std::ifstream::failure &)
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+	}
+
+	const char* cShaderCode = computeCode.c_str();
+	unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(computeShader, 1, &cShaderCode, NULL);
+	glCompileShader(computeShader);
+	int  success;
+	char infoLog[512];
+	glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	if (ID != -1)
+		glDeleteProgram(ID);
+
+	ID = glCreateProgram();
+	glAttachShader(ID, computeShader);
+	glLinkProgram(ID);
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+	glDeleteShader(computeShader);
 }
 
 void Shader::Use() const
@@ -0,0 +1,144 @@
+#include "graphics/UploadRing.h"
+
+#include <iostream>
+#include <cstring>
+
+UploadRing::UploadRing() :
+	m_buffer(0),
+	m_data(nullptr),
+	m_capacity(0),
+	m_head(0),
+	m_used(0),
+	m_frontId(1),
+	m_frame(1),
+	m_copiedThisFrame(false),
+	m_completedFrame(0)
+{
+}
+
+bool UploadRing::Init(size_t capacity)
+{
+	if (!GLAD_GL_VERSION_4_4)
+		return false;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	glBufferStorage(GL_COPY_READ_BUFFER, (GLsizeiptr)capacity, nullptr, flags);
+	uint8_t * data = (uint8_t *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)capacity, flags);
+	if (!data)
+	{
+		std::cerr << "ERROR: UploadRing::Init cannot map " << capacity << " bytes" << std::endl;
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_capacity = capacity;
+	m_data = data;
+	return true;
+}
+
+UploadRing::Slice UploadRing::Write(const void * data, size_t size)
+{
+	Slice slice;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_data || size == 0 || size > m_capacity)
+			return slice;
+
+		//A slice never wraps, the end of the ring is skipped when too small
+		bool wrap = m_head + size > m_capacity;
+		size_t offset = wrap ? 0 : m_head;
+		size_t skipped = wrap ? m_capacity - m_head : 0;
+		if (m_used + skipped + size > m_capacity)
+			return slice;
+
+		m_entries.push_back({ skipped + size, false, 0 });
+		m_head = offset + size;
+		m_used += skipped + size;
+
+		slice.id = m_frontId + m_entries.size() - 1;
+		slice.offset = offset;
+		slice.size = size;
+	}
+
+	//The slice is reserved, the copy does not hold the lock
+	std::memcpy(m_data + slice.offset, data, size);
+	return slice;
+}
+
+void UploadRing::Copy(const Slice & slice, GLenum target, GLintptr offset)
+{
+	if (slice.size == 0)
+		return;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, target, (GLintptr)slice.offset, offset, (GLsizeiptr)slice.size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries[slice.id - m_frontId].frame = m_frame;
+	m_copiedThisFrame = true;
+}
+
+void UploadRing::Release(Slice & slice)
+{
+	if (slice.size == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries[slice.id - m_frontId].released = true;
+	slice = Slice();
+}
+
+void UploadRing::EndFrame()
+{
+	if (m_copiedThisFrame)
+	{
+		m_fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_frame });
+		m_copiedThisFrame = false;
+	}
+	++m_frame;
+	Retire();
+}
+
+void UploadRing::Retire()
+{
+	//Polls the fences without waiting, in submission order
+	while (!m_fences.empty())
+	{
+		GLenum status = glClientWaitSync(m_fences.front().sync, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		m_completedFrame = m_fences.front().frame;
+		glDeleteSync(m_fences.front().sync);
+		m_fences.pop_front();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_entries.empty() && m_entries.front().released && m_entries.front().frame <= m_completedFrame)
+	{
+		m_used -= m_entries.front().size;
+		m_entries.pop_front();
+		++m_frontId;
+	}
+	if (m_entries.empty())
+		m_head = 0;
+}
+
+unsigned int UploadRing::Buffer() const { return m_buffer; }
+size_t UploadRing::Capacity() const { return m_capacity; }
+size_t UploadRing::Used() const { return m_used; }
+
+UploadRing::~UploadRing()
+{
+	for (Fence & fence : m_fences)
+		glDeleteSync(fence.sync);
+	if (m_buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glDeleteBuffers(1, &m_buffer);
+	}
+}
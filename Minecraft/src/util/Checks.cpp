@@ -0,0 +1,269 @@
+#include "util/Checks.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "graphics/UploadRing.h"
+#include "util/OcclusionBuffer.h"
+#include "engine/map/MeshCache.h"
+#include "engine/map/ChunckPool.h"
+
+int Checks::Main(int argc, char ** argv)
+{
+	//Minecraft --check [name] runs the named check alone
+	const std::string only = argc > 2 ? argv[2] : "";
+	int failed = 0;
+	if (only.empty() || only == "ring")
+		failed += Ring() ? 0 : 1;
+	if (only.empty() || only == "occlusion")
+		failed += Occlusion() ? 0 : 1;
+	if (only.empty() || only == "meshcache")
+		failed += MeshCache() ? 0 : 1;
+	std::cout << (failed == 0 ? "Every check passed" : "Some checks failed") << std::endl;
+	return failed;
+}
+
+bool Checks::Expect(bool condition, const std::string & check, const std::string & what)
+{
+	if (!condition)
+		std::cerr << "ERROR: Checks::" << check << " " << what << std::endl;
+	return condition;
+}
+
+GLFWwindow * Checks::CreateContext()
+{
+	if (!glfwInit())
+		return nullptr;
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow * window = glfwCreateWindow(64, 64, "Checks", NULL, NULL);
+	if (!window)
+	{
+		glfwTerminate();
+		return nullptr;
+	}
+
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return nullptr;
+	}
+	return window;
+}
+
+bool Checks::Ring()
+{
+	GLFWwindow * window = CreateContext();
+	if (!window || !GLAD_GL_VERSION_4_4)
+	{
+		std::cout << "UploadRing: skipped, needs an OpenGL 4.4 context" << std::endl;
+		if (window)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		return true;
+	}
+
+	bool passed = true;
+	{
+		const size_t capacity = 1024;
+		UploadRing ring;
+		passed &= Expect(ring.Init(capacity), "Ring", "cannot map the ring");
+
+		std::vector<uint8_t> data(capacity);
+		for (size_t i = 0; i < data.size(); ++i)
+			data[i] = (uint8_t)(i * 7 + 3);
+
+		unsigned int target;
+		glGenBuffers(1, &target);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+
+		//The first writes of an empty ring follow each other
+		UploadRing::Slice a = ring.Write(data.data(), 400);
+		UploadRing::Slice b = ring.Write(data.data() + 400, 400);
+		passed &= Expect(a.size == 400 && a.offset == 0, "Ring", "first write of an empty ring failed");
+		passed &= Expect(b.size == 400 && b.offset == 400, "Ring", "second write does not follow the first");
+		passed &= Expect(ring.Used() == 800, "Ring", "used bytes do not match the writes");
+
+		//Full: the end is too small and the start is still in use
+		UploadRing::Slice full = ring.Write(data.data(), 300);
+		passed &= Expect(full.size == 0, "Ring", "write succeeded in a full ring");
+
+		//The first slice is copied, released, then recycled once its fence is signaled
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+		ring.Copy(a, GL_COPY_WRITE_BUFFER, 0);
+		ring.Release(a);
+		ring.EndFrame();
+		glFinish();
+		ring.EndFrame();
+		passed &= Expect(ring.Used() == 400, "Ring", "released slice not recycled after its fence");
+
+		//Wraps to the start, the end of the ring is skipped
+		UploadRing::Slice c = ring.Write(data.data() + 600, 300);
+		passed &= Expect(c.size == 300 && c.offset == 0, "Ring", "write did not wrap to the start");
+		passed &= Expect(ring.Used() == 400 + 224 + 300, "Ring", "skipped end of the ring not counted");
+		UploadRing::Slice over = ring.Write(data.data(), 200);
+		passed &= Expect(over.size == 0, "Ring", "write after the wrap overlaps a slice in use");
+
+		//The wrapped slice reaches the target buffer
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+		ring.Copy(c, GL_COPY_WRITE_BUFFER, 400);
+		ring.Release(b);
+		ring.Release(c);
+		ring.EndFrame();
+		glFinish();
+		ring.EndFrame();
+		std::vector<uint8_t> copied(capacity);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+		glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, capacity, copied.data());
+		passed &= Expect(std::equal(data.begin(), data.begin() + 400, copied.begin()), "Ring", "first slice copied wrong");
+		passed &= Expect(std::equal(data.begin() + 600, data.begin() + 900, copied.begin() + 400), "Ring", "wrapped slice copied wrong");
+		passed &= Expect(ring.Used() == 0, "Ring", "ring not empty once every slice is retired");
+
+		//Empty again, the next write starts the ring over
+		UploadRing::Slice d = ring.Write(data.data(), capacity);
+		passed &= Expect(d.size == capacity && d.offset == 0, "Ring", "whole ring cannot be written once empty");
+		ring.Release(d);
+		ring.EndFrame();
+
+		glDeleteBuffers(1, &target);
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	std::cout << "UploadRing: " << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
+
+bool Checks::Occlusion()
+{
+	//Eye at the origin looking down -z, a 10 x 10 wall 10 units away
+	const glm::vec3 eye(0.f);
+	const glm::mat4 projView = glm::perspective(glm::radians(60.f), 2.f, 0.1f, 100.f) * glm::lookAt(eye, glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	const glm::vec4 wall[4] = { projView * glm::vec4(-5.f, -5.f, -10.f, 1.f), projView * glm::vec4(5.f, -5.f, -10.f, 1.f), projView * glm::vec4(5.f, 5.f, -10.f, 1.f), projView * glm::vec4(-5.f, 5.f, -10.f, 1.f) };
+
+	bool passed = true;
+	OcclusionBuffer buffers[2];
+	for (int simd = 0; simd < 2; ++simd)
+	{
+		OcclusionBuffer & buffer = buffers[simd];
+		buffer.SetSimd(simd == 1);
+		buffer.Clear(projView, eye);
+		buffer.DrawTriangle(wall[0], wall[1], wall[2]);
+		buffer.DrawTriangle(wall[0], wall[2], wall[3]);
+		const std::string path = simd == 1 ? " (SSE)" : " (scalar)";
+		passed &= Expect(buffer.Triangles() == 2, "Occlusion", "wall not rasterized" + path);
+		passed &= Expect(!buffer.TestBox(glm::vec3(-1.f, -1.f, -21.f), glm::vec3(1.f, 1.f, -20.f)), "Occlusion", "box behind the wall visible" + path);
+		passed &= Expect(buffer.TestBox(glm::vec3(14.f, -1.f, -21.f), glm::vec3(16.f, 1.f, -20.f)), "Occlusion", "box beside the wall hidden" + path);
+		passed &= Expect(buffer.TestBox(glm::vec3(-1.f, -1.f, -9.f), glm::vec3(1.f, 1.f, -8.f)), "Occlusion", "box in front of the wall hidden" + path);
+		passed &= Expect(buffer.TestBox(glm::vec3(-1.f, -1.f, -30.f), glm::vec3(1.f, 1.f, 0.05f)), "Occlusion", "box crossing the near plane hidden" + path);
+
+		//Occluder boxes of random sizes all around the eye, some crossing the near plane
+		uint32_t seed = 12345;
+		std::function<float()> random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.f; };
+		for (int i = 0; i < 200; ++i)
+		{
+			glm::vec3 min(random() * 60.f - 30.f, random() * 30.f - 15.f, -random() * 60.f);
+			buffer.DrawBox(min, min + glm::vec3(0.5f + random() * 4.f, 0.5f + random() * 4.f, 0.5f + random() * 4.f));
+		}
+	}
+
+	//Both paths see the same scene
+	bool sameDepths = buffers[0].Triangles() == buffers[1].Triangles();
+	for (int y = 0; y < OcclusionBuffer::height && sameDepths; ++y)
+		for (int x = 0; x < OcclusionBuffer::width && sameDepths; ++x)
+			sameDepths = buffers[0].Depth(x, y) == buffers[1].Depth(x, y);
+	passed &= Expect(sameDepths, "Occlusion", "SSE and scalar depths differ");
+	for (int x = -20; x < 20; ++x)
+		for (int z = 1; z < 40; ++z)
+		{
+			const glm::vec3 min((float)x * 1.5f, -1.f, -(float)z * 1.5f);
+			passed &= Expect(buffers[0].TestBox(min, min + glm::vec3(1.f)) == buffers[1].TestBox(min, min + glm::vec3(1.f)), "Occlusion", "SSE and scalar tests differ");
+		}
+
+	std::cout << "Occlusion: " << (passed ? "passed" : "FAILED") << (OcclusionBuffer::SimdSupported() ? "" : ", no SSE in this build, the scalar path was compared with itself") << std::endl;
+	return passed;
+}
+
+bool Checks::MeshCache()
+{
+	GLFWwindow * window = CreateContext();
+	if (!window || !GLAD_GL_VERSION_4_4)
+	{
+		std::cout << "MeshCache: skipped, needs an OpenGL 4.4 context" << std::endl;
+		if (window)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		return true;
+	}
+
+	bool passed = true;
+	{
+		//Scratch directory, the world meshes are not touched
+		const std::string directory = "world/checks/meshes";
+		const std::string region = directory + "/m.0.0.meshes";
+		std::remove(region.c_str());
+
+		ChunckPool pool(0);
+		pool.Arena().EndFrame();//Maps the upload ring
+
+		//The first subChunck with faces of a generated chunck
+		Chunck * chunck = pool.Acquire(0, 0);
+		chunck->GenerateBlocks();
+		SubChunck * subChunck = nullptr;
+		for (int y = 0; y < Chunck::height && !subChunck; ++y)
+			if (chunck->GetSubChunck(y)->HasFaces())
+				subChunck = chunck->GetSubChunck(y);
+		passed &= Expect(subChunck != nullptr, "MeshCache", "generated chunck has no face");
+
+		if (subChunck)
+		{
+			subChunck->GenerateMesh();
+			const size_t opaqueBytes = subChunck->m_verticesOpaque.size() * sizeof(Mesh::Vertex);
+			const size_t transparentBytes = subChunck->m_verticesTransparent.size() * sizeof(Mesh::Vertex);
+			const uint64_t hash = subChunck->ContentHash();
+			{
+				::MeshCache cache(directory);
+				cache.SetEnabled(true);
+				cache.Save(subChunck, hash, 1.f);
+				cache.Flush();
+			}
+			subChunck->m_verticesOpaque.clear();
+			subChunck->m_verticesTransparent.clear();
+
+			//Read back from the region file by a new cache, as after a restart
+			::MeshCache cache(directory);
+			cache.SetEnabled(true);
+			float meshTime = 0.f;
+			passed &= Expect(!cache.Load(subChunck, hash + 1, meshTime), "MeshCache", "mesh of other blocks loaded");
+			passed &= Expect(cache.Load(subChunck, hash, meshTime) && meshTime == 1.f, "MeshCache", "saved mesh not loaded");
+
+			//Staged in the ring, the main thread only queues a GPU copy
+			passed &= Expect(subChunck->m_stagedOpaque.size == opaqueBytes && subChunck->m_stagedTransparent.size == transparentBytes, "MeshCache", "loaded mesh not staged in the upload ring");
+			passed &= Expect(subChunck->m_verticesOpaque.empty() && subChunck->m_verticesTransparent.empty(), "MeshCache", "loaded mesh kept for a synchronous upload");
+			subChunck->GenerateModels();
+			passed &= Expect(subChunck->m_meshOpaque.count * sizeof(Mesh::Vertex) == opaqueBytes && subChunck->m_meshTransparent.count * sizeof(Mesh::Vertex) == transparentBytes, "MeshCache", "staged mesh not allocated in the mesh arena");
+			passed &= Expect(subChunck->m_stagedOpaque.size == 0 && subChunck->m_stagedTransparent.size == 0, "MeshCache", "staged slices not released");
+		}
+
+		pool.Release(chunck);
+		std::remove(region.c_str());
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	std::cout << "MeshCache: " << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,88 @@
+#include "util/Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < planesCount; ++i)
+		planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+Frustum::Frustum(const glm::mat4 & projView, float margin)
+{
+	//Rows of the matrix, glm is column major
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(projView[0][i], projView[1][i], projView[2][i], projView[3][i]);
+
+	planes[leftPlane] = rows[3] + rows[0];
+	planes[rightPlane] = rows[3] - rows[0];
+	planes[bottomPlane] = rows[3] + rows[1];
+	planes[topPlane] = rows[3] - rows[1];
+	planes[nearPlane] = rows[3] + rows[2];
+	planes[farPlane] = rows[3] - rows[2];
+
+	//Normalized so that w is a distance and the margin is in world units
+	for (int i = 0; i < planesCount; ++i)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+		planes[i].w += margin;
+	}
+}
+
+Frustum::Result Frustum::TestBox(glm::vec3 min, glm::vec3 max) const
+{
+	Result result = inside;
+	for (int i = 0; i < planesCount; ++i)
+	{
+		const glm::vec4 & plane = planes[i];
+
+		//Corner the furthest along the normal, then the opposite one
+		glm::vec3 positive(plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y, plane.z > 0 ? max.z : min.z);
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0)
+			return outside;
+		glm::vec3 negative(plane.x > 0 ? min.x : max.x, plane.y > 0 ? min.y : max.y, plane.z > 0 ? min.z : max.z);
+		if (glm::dot(glm::vec3(plane), negative) + plane.w < 0)
+			result = intersect;
+	}
+	return result;
+}
+
+uint32_t Frustum::TestColumn(glm::vec3 min, glm::vec3 cellSize, int cells) const
+{
+	uint32_t visible = 0;
+	glm::vec3 max = min + cellSize;
+
+#ifdef FRUSTUM_SSE
+	//Structure of arrays: the boxes of a column share x and z, only the y of the 4 lanes differ
+	const __m128 zero = _mm_setzero_ps();
+	for (int first = 0; first < cells; first += 4)
+	{
+		__m128 lanes = _mm_setr_ps((float)first, (float)first + 1, (float)first + 2, (float)first + 3);
+		__m128 minY = _mm_add_ps(_mm_set1_ps(min.y), _mm_mul_ps(lanes, _mm_set1_ps(cellSize.y)));
+		__m128 maxY = _mm_add_ps(minY, _mm_set1_ps(cellSize.y));
+
+		__m128 out = zero;
+		for (int i = 0; i < planesCount; ++i)
+		{
+			const glm::vec4 & plane = planes[i];
+			float xz = plane.x * (plane.x > 0 ? max.x : min.x) + plane.z * (plane.z > 0 ? max.z : min.z) + plane.w;
+			__m128 distance = _mm_add_ps(_mm_set1_ps(xz), _mm_mul_ps(_mm_set1_ps(plane.y), plane.y > 0 ? maxY : minY));
+			out = _mm_or_ps(out, _mm_cmplt_ps(distance, zero));
+		}
+		visible |= (uint32_t)(~_mm_movemask_ps(out) & 0xF) << first;
+	}
+#else
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		glm::vec3 offset(0.f, cell * cellSize.y, 0.f);
+		if (TestBox(min + offset, max + offset) != outside)
+			visible |= 1u << cell;
+	}
+#endif
+
+	return cells < 32 ? visible & ((1u << cells) - 1) : visible;
+}
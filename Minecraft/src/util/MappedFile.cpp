@@ -0,0 +1,113 @@
+#include "util/MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0),
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr)
+{
+}
+
+bool MappedFile::Open(const std::string & path)
+{
+	Close();
+
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping)
+		m_data = (const uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+	m_size = 0;
+}
+
+#else
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0),
+	m_file(-1)
+{
+}
+
+bool MappedFile::Open(const std::string & path)
+{
+	Close();
+
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void * data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = (const uint8_t *)data;
+	m_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data) munmap((void *)m_data, m_size);
+	if (m_file >= 0) close(m_file);
+	m_data = nullptr;
+	m_file = -1;
+	m_size = 0;
+}
+
+#endif
+
+const uint8_t * MappedFile::Data() const { return m_data; }
+size_t MappedFile::Size() const { return m_size; }
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
@@ -0,0 +1,193 @@
+#include "util/OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float minW = 1e-3f;//Vertices closer to the eye plane are not projected
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+	m_projView(1.f),
+	m_eye(0.f),
+	m_depths(width * height, 1.f),
+	m_triangles(0),
+	m_simd(SimdSupported())
+{
+	static_assert(width % 4 == 0, "Rows are rasterized 4 pixels at a time");
+}
+
+void OcclusionBuffer::Clear(const glm::mat4 & projView, glm::vec3 eye)
+{
+	m_projView = projView;
+	m_eye = eye;
+	m_triangles = 0;
+	std::fill(m_depths.begin(), m_depths.end(), 1.f);
+}
+
+glm::vec3 OcclusionBuffer::ToScreen(glm::vec4 clip) const
+{
+	return glm::vec3((0.5f * clip.x / clip.w + 0.5f) * width, (0.5f * clip.y / clip.w + 0.5f) * height, clip.z / clip.w);
+}
+
+void OcclusionBuffer::DrawBox(glm::vec3 min, glm::vec3 max)
+{
+	glm::vec4 corners[8];
+	for (int i = 0; i < 8; ++i)
+		corners[i] = m_projView * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.f);
+
+	//Corners of each face as bits of their index (x = 1, y = 2, z = 4), the face is seen when the eye is on its side
+	const int faces[6][4] = { { 1, 3, 7, 5 }, { 0, 4, 6, 2 }, { 2, 6, 7, 3 }, { 0, 1, 5, 4 }, { 4, 5, 7, 6 }, { 0, 2, 3, 1 } };
+	const bool seen[6] = { m_eye.x > max.x, m_eye.x < min.x, m_eye.y > max.y, m_eye.y < min.y, m_eye.z > max.z, m_eye.z < min.z };
+	for (int face = 0; face < 6; ++face)
+		if (seen[face])
+		{
+			DrawTriangle(corners[faces[face][0]], corners[faces[face][1]], corners[faces[face][2]]);
+			DrawTriangle(corners[faces[face][0]], corners[faces[face][2]], corners[faces[face][3]]);
+		}
+}
+
+void OcclusionBuffer::DrawTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2)
+{
+	if (v0.w < minW || v1.w < minW || v2.w < minW)
+		return;
+
+	glm::vec3 p0 = ToScreen(v0);
+	glm::vec3 p1 = ToScreen(v1);
+	glm::vec3 p2 = ToScreen(v2);
+
+	//Counter clockwise, the edge functions are positive inside
+	float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	if (std::abs(area) < 1e-6f)
+		return;
+	if (area < 0)
+	{
+		std::swap(p1, p2);
+		area = -area;
+	}
+
+	int minX = std::max(0, (int)std::floor(std::min(p0.x, std::min(p1.x, p2.x))));
+	int maxX = std::min(width - 1, (int)std::ceil(std::max(p0.x, std::max(p1.x, p2.x))));
+	int minY = std::max(0, (int)std::floor(std::min(p0.y, std::min(p1.y, p2.y))));
+	int maxY = std::min(height - 1, (int)std::ceil(std::max(p0.y, std::max(p1.y, p2.y))));
+	if (minX > maxX || minY > maxY)
+		return;
+	++m_triangles;
+
+	//Edge (a, b): (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x) = A * x + B * y + C
+	const glm::vec3 * vertices[3] = { &p0, &p1, &p2 };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const glm::vec3 & a = *vertices[i];
+		const glm::vec3 & b = *vertices[(i + 1) % 3];
+		edgeA[i] = a.y - b.y;
+		edgeB[i] = b.x - a.x;
+		edgeC[i] = a.x * b.y - a.y * b.x;
+	}
+
+	//The depth is a plane in screen space, weighted by the edge opposite to each vertex
+	float zA = (edgeA[1] * p0.z + edgeA[2] * p1.z + edgeA[0] * p2.z) / area;
+	float zB = (edgeB[1] * p0.z + edgeB[2] * p1.z + edgeB[0] * p2.z) / area;
+	float zC = (edgeC[1] * p0.z + edgeC[2] * p1.z + edgeC[0] * p2.z) / area;
+
+	minX &= ~3;
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float centerY = y + 0.5f;
+		float * row = &m_depths[y * width];
+#ifdef OCCLUSION_SSE
+		if (m_simd)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 steps = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), steps);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[0]), centerX), _mm_set1_ps(edgeB[0] * centerY + edgeC[0])), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[1]), centerX), _mm_set1_ps(edgeB[1] * centerY + edgeC[1])), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[2]), centerX), _mm_set1_ps(edgeB[2] * centerY + edgeC[2])), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), centerX), _mm_set1_ps(zB * centerY + zC));
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 closest = _mm_min_ps(old, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, old)));
+			}
+			continue;
+		}
+#endif
+		//Same pixels and operations in the same order as the SSE path, the depths are identical
+		for (int x = minX; x <= (maxX | 3); ++x)
+		{
+			float centerX = x + 0.5f;
+			if (edgeA[0] * centerX + (edgeB[0] * centerY + edgeC[0]) >= 0 &&
+				edgeA[1] * centerX + (edgeB[1] * centerY + edgeC[1]) >= 0 &&
+				edgeA[2] * centerX + (edgeB[2] * centerY + edgeC[2]) >= 0)
+				row[x] = std::min(row[x], zA * centerX + (zB * centerY + zC));
+		}
+	}
+}
+
+bool OcclusionBuffer::TestBox(glm::vec3 min, glm::vec3 max) const
+{
+	//Screen rectangle and closest depth of the box
+	glm::vec2 rectMin(width, height);
+	glm::vec2 rectMax(0.f);
+	float closest = 1.f;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec4 clip = m_projView * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.f);
+		if (clip.w < minW)
+			return true;
+		glm::vec3 screen = ToScreen(clip);
+		rectMin = glm::min(rectMin, glm::vec2(screen));
+		rectMax = glm::max(rectMax, glm::vec2(screen));
+		closest = std::min(closest, screen.z);
+	}
+
+	int minX = std::max(0, (int)std::floor(rectMin.x));
+	int maxX = std::min(width - 1, (int)std::floor(rectMax.x));
+	int minY = std::max(0, (int)std::floor(rectMin.y));
+	int maxY = std::min(height - 1, (int)std::floor(rectMax.y));
+	if (minX > maxX || minY > maxY)
+		return true;
+
+	//Visible as soon as one pixel of the rectangle has no occluder in front of the box
+	for (int y = minY; y <= maxY; ++y)
+	{
+		const float * row = &m_depths[y * width];
+		int x = minX;
+#ifdef OCCLUSION_SSE
+		const __m128 depth = _mm_set1_ps(closest);
+		for (; m_simd && x + 3 <= maxX; x += 4)
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), depth)) != 0)
+				return true;
+#endif
+		for (; x <= maxX; ++x)
+			if (row[x] >= closest)
+				return true;
+	}
+	return false;
+}
+
+int OcclusionBuffer::Triangles() const { return m_triangles; }
+float OcclusionBuffer::Depth(int x, int y) const { return m_depths[y * width + x]; }
+
+bool OcclusionBuffer::SimdSupported()
+{
+#ifdef OCCLUSION_SSE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void OcclusionBuffer::SetSimd(bool state) { m_simd = state && SimdSupported(); }